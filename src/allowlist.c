@@ -0,0 +1,80 @@
+#include <stdlib.h>
+#include <string.h>
+#include "util.h"
+#include "vsub.h"
+
+
+// immutable set of var names; a bloom filter over a cheap fingerprint rejects
+// most names before the name is hashed and looked up
+#define ALLOW_BLOOM_BITS 1024
+
+struct VsubAllowlist {
+    uint64_t bloom[ALLOW_BLOOM_BITS / 64];
+    StrMap index;  // owns copies of names
+};
+
+// length and outer chars only, so no pass over the whole name is needed
+static uint32_t allow_fingerprint(const char *var, size_t len) {
+    return ((uint32_t)len * 0x9e3779b1u) ^ ((unsigned char)var[0] * 0x85ebca6bu) ^
+        ((unsigned char)var[len - 1] * 0xc2b2ae35u);
+}
+
+#define BLOOM_BIT1(f) ((f) % ALLOW_BLOOM_BITS)
+#define BLOOM_BIT2(f) (((f) >> 16) % ALLOW_BLOOM_BITS)
+#define BLOOM_HAS(b, bit) ((b)[(bit) / 64] & ((uint64_t)1 << ((bit) % 64)))
+
+VsubAllowlist *vsub_CompileAllowlist(size_t c, const char *names[]) {
+    VsubAllowlist *list = malloc(sizeof(VsubAllowlist));
+    if (!list) {
+        return NULL;
+    }
+    memset(list->bloom, 0, sizeof(list->bloom));
+    map_init(&list->index, &VSUB_ALLOC_LIBC);
+    for (size_t i = 0; i < c; i++) {
+        size_t len = strlen(names[i]);
+        if (len == 0) {
+            continue;
+        }
+        uint64_t hash = hash_str(names[i], len);
+        if (map_find(&list->index, names[i], len, hash)) {
+            continue;
+        }
+        char *name = malloc(len + 1);
+        bool found;
+        if (!name) {
+            vsub_FreeAllowlist(list);
+            return NULL;
+        }
+        memcpy(name, names[i], len + 1);
+        if (!map_insert(&list->index, name, len, hash, &found)) {
+            free(name);
+            vsub_FreeAllowlist(list);
+            return NULL;
+        }
+        uint32_t f = allow_fingerprint(name, len);
+        list->bloom[BLOOM_BIT1(f) / 64] |= (uint64_t)1 << (BLOOM_BIT1(f) % 64);
+        list->bloom[BLOOM_BIT2(f) / 64] |= (uint64_t)1 << (BLOOM_BIT2(f) % 64);
+    }
+    return list;
+}
+
+bool vsub_AllowsVar(const VsubAllowlist *list, const char *var, size_t len) {
+    if (len == 0) {
+        return false;
+    }
+    uint32_t f = allow_fingerprint(var, len);
+    if (!BLOOM_HAS(list->bloom, BLOOM_BIT1(f)) || !BLOOM_HAS(list->bloom, BLOOM_BIT2(f))) {
+        return false;
+    }
+    return map_find(&list->index, var, len, hash_str(var, len)) != NULL;
+}
+
+void vsub_FreeAllowlist(VsubAllowlist *list) {
+    if (list) {
+        for (size_t i = 0; i < list->index.avail; i++) {
+            free((char *)list->index.items[i].key);
+        }
+        map_free(&list->index);
+        free(list);
+    }
+}
@@ -0,0 +1,110 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aux.h"
+
+
+// bump arena: allocations are carved from blocks, all memory is freed at once
+// when context is freed; freeing or growing the last allocation reuses its
+// space, other frees are ignored
+
+#define ARENA_BLOCK 262144  // default block size
+#define ARENA_ALIGN 16      // allocation alignment, also size of headers
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *prev;
+} ArenaBlock;
+
+typedef struct Arena {
+    VsubAllocator super;
+    size_t block;      // block size
+    ArenaBlock *last;  // last allocated block
+    char *next;        // unused space of the last block
+    char *end;
+    char *top;         // last allocation, or NULL
+} Arena;
+
+// allocation is preceded by its size
+#define ARENA_SIZE(ptr) (*(size_t *)((char *)(ptr) - ARENA_ALIGN))
+
+static void *arena_malloc(Arena *arena, size_t size) {
+    size_t need = ARENA_ALIGN + ARENA_ROUND(size);
+    if ((size_t)(arena->end - arena->next) < need) {
+        size_t bsize = MAX(arena->block, ARENA_ALIGN + need);
+        ArenaBlock *block = malloc(bsize);
+        if (!block) {
+            return NULL;
+        }
+        block->prev = arena->last;
+        arena->last = block;
+        arena->next = (char *)block + ARENA_ALIGN;
+        arena->end = (char *)block + bsize;
+    }
+    arena->top = arena->next + ARENA_ALIGN;
+    arena->next += need;
+    ARENA_SIZE(arena->top) = size;
+    return arena->top;
+}
+
+static void *arena_realloc(Arena *arena, void *ptr, size_t size) {
+    if (!ptr) {
+        return arena_malloc(arena, size);
+    }
+    size_t cur = ARENA_SIZE(ptr);
+    if (ptr == arena->top && (size_t)(arena->end - (char *)ptr) >= ARENA_ROUND(size)) {
+        arena->next = (char *)ptr + ARENA_ROUND(size);  // grow or shrink in place
+        ARENA_SIZE(ptr) = size;
+        return ptr;
+    }
+    if (size <= cur) {
+        return ptr;
+    }
+    void *newptr = arena_malloc(arena, size);
+    if (newptr) {
+        memcpy(newptr, ptr, cur);
+    }
+    return newptr;
+}
+
+static void arena_free(Arena *arena, void *ptr) {
+    if (ptr && ptr == arena->top) {
+        arena->next = (char *)ptr - ARENA_ALIGN;
+        arena->top = NULL;
+    }
+}
+
+static void arena_release(Arena *arena) {
+    ArenaBlock *block = arena->last;
+    while (block) {
+        ArenaBlock *prev = block->prev;
+        free(block);
+        block = prev;
+    }
+    free(arena);
+}
+
+bool vsub_init_arena(Vsub *sub, size_t block) {
+    Arena *arena = malloc(sizeof(Arena));
+    if (arena) {
+        arena->super.malloc = (void *(*)(void *, size_t))arena_malloc;
+        arena->super.realloc = (void *(*)(void *, void *, size_t))arena_realloc;
+        arena->super.free = (void (*)(void *, void *))arena_free;
+        arena->super.release = (void (*)(void *))arena_release;
+        arena->super.data = arena;
+        arena->block = block ? block : ARENA_BLOCK;
+        arena->last = NULL;
+        arena->next = arena->end = arena->top = NULL;
+    }
+    // context of libc allocator is still safe to free on failure
+    return vsub_init_alloc(sub, arena ? &arena->super : &VSUB_ALLOC_LIBC) && arena;
+}
+
+// arena is not thread safe, so every context gets its own
+bool vsub_init_like(Vsub *sub, const Vsub *parent) {
+    const VsubAllocator *alloc = parent->alloc;
+    if (alloc->release == (void (*)(void *))arena_release) {
+        return vsub_init_arena(sub, ((Arena *)alloc->data)->block);
+    }
+    return vsub_init_alloc(sub, alloc);
+}
@@ -1,15 +1,23 @@
 #ifndef VSUB_AUX_H
 #define VSUB_AUX_H
 
+#include <setjmp.h>
+#include "util.h"
 #include "vsub.h"
 
 
 // --- parsers
 
+// view of parsed input, valid until the action of current atom returns
+typedef struct VsubSpan {
+    const char *ptr;
+    size_t len;
+} VsubSpan;
+
 // implemented syntax parser description
 typedef struct VsubParser {
     void *(*create)(void *aux);
-    int (*parse)(void *ctx, void *ret);
+    int (*parse)(void *ctx, void *ret);  // called until 0, at end of input or on error
     void (*destroy)(void *ctx);
 } VsubParser;
 
@@ -17,58 +25,144 @@ typedef struct VsubParser {
 extern const VsubParser VSUB_PARSERS[];  // using VSUB_SX_* as indexes
 #define VSUB_PARSERS_COUNT VSUB_SYNTAXES_COUNT
 
+// scanning parser description, handles all syntaxes
+extern const VsubParser VSUB_SCANNER;
+
 
 // --- auxiliary object
 
+// parser memory pool size classes, blocks of larger size are not pooled
+#define VSUB_POOL_STEP 16  // small block size step
+#define VSUB_POOL_SMALL 512  // largest small block, larger blocks have power of 2 sizes
+#define VSUB_POOL_CLASSES 46  // up to 8M blocks, holding initial packcc recycler pools
+
+typedef struct VsubPool {
+    void *free[VSUB_POOL_CLASSES];  // free blocks by size class
+    void *heads;  // slabs and large blocks, freed on release
+    char *next;   // unused slabs of the last allocation
+    char *end;
+} VsubPool;
+
+// var lookup memo, direct mapped by name hash; holds results of the current
+// run only, including unset vars, so that sources are searched once per name
+#define VSUB_MEMO_SIZE 64  // entries, power of 2
+#define VSUB_MEMO_NAME 32  // longest memoized name, longer names are always searched
+
+typedef struct VsubMemo {
+    const char *value;  // lookup result, may be NULL or VSUB_VALUE_KEEP
+    size_t vlen;
+    unsigned gen;       // run the entry belongs to
+    unsigned char len;  // name length, 0 if unused
+    char name[VSUB_MEMO_NAME];
+} VsubMemo;
+
 typedef struct Auxil {
     Vsub *sub;
     // syntax methods
-    int (*getchar)(void *aux);
-    const char *(*getvalue)(void *aux, const char *var);
-    bool (*append_orig)(void *aux, int epos, const char *str);
-    bool (*append_subst)(void *aux, int epos, const char *str);
-    bool (*append_error)(void *aux, int epos, const char *errvar, const char* errmsg);
+    int (*getchar)(void *aux);  // slow path of PCC_GETCHAR, refills input buffer
+    size_t (*read)(void *aux, char *buf, size_t n);
+    bool (*view)(void *aux, const char **ptr, size_t *len);  // consume the rest in place
+    const char *(*getvalue)(void *aux, const char *var, size_t len, size_t *vlen);
+    bool (*append_orig)(void *aux, size_t epos, const char *str, size_t len);
+    bool (*append_subst)(void *aux, size_t epos, const char *str, size_t len);
+    bool (*append_error)(void *aux, size_t epos, const char *errvar, const char* errmsg);
     // data
-    char *resbuf;  // result buffer
+    const char *inp;  // input block, either input buffer or text source view
+    size_t inpn;   // input block length
+    size_t inpi;   // next input byte index
+    size_t inpo;   // input offset of input block
+    char *inpbuf;  // input buffer
+    size_t inpz;   // input buffer size
+    bool eof;      // text source reached end of input or was consumed in place
+    char *resbuf;  // result buffer, or output buffer if writing to sink
     size_t resz;   // result buffer size
+    size_t resn;   // output bytes buffered but not yet written to sink
     char *errbuf;  // error buffer
     size_t errz;   // error buffer size
     // parser
     const VsubParser *parser;
     void *pctx;
+    size_t base;    // input offset of parser context, action positions are relative to it
+    VsubPool pool;  // parser memory
+    jmp_buf oom;    // parser memory errors jump here
+    // templates
+    void *tpl;       // template being compiled
+    VsubSpan *vals;  // values of template vars being rendered
+    size_t valz;     // values buffer size
+    // var references
+    void *refs;      // found by last vsub_scan_vars
+    // var lookups
+    VsubMemo memo[VSUB_MEMO_SIZE];
+    unsigned memogen;  // current run, entries of other runs are stale
 } Auxil;
 
 // buffer management constants
+#define VSUB_BINP_SIZE 65536  // input block size
 #define VSUB_BRES_MIN 256  // initial result buffer size
-#define VSUB_BRES_INC 1024 // additional free space reserved on every reallocation
+#define VSUB_BRES_MAX_INC (16 * 1024 * 1024)  // max result buffer growth on reallocation
 #define VSUB_BERR_MIN 256  // initial error buffer size
+#define VSUB_BOUT_SIZE 65536  // output buffer size
+#define VSUB_CHUNK_MIN 65536  // smallest input chunk rendered by separate thread
+#define VSUB_PCTX_SPAN 4096  // input parsed before packcc context is recreated
+
+
+// --- internal api
+
+extern const char VSUB_VALUE_KEEP[];  // getvalue result for vars to be kept as is
+
+bool vsub_init_like(Vsub *sub, const Vsub *parent);  // use allocator of parent
+void vsub_clear_results(Vsub *sub);
+void vsub_clear_memo(Vsub *sub);  // forget var lookups, sources may have changed
+bool vsub_flush_results(Vsub *sub);  // write buffered output to sink
+bool vsub_run_chunks(Vsub *sub, const char *ptr, size_t len);  // render input view on threads
+void vsub_free_refs(Vsub *sub);
+
+// parser memory is recycled between runs; generated parsers don't check
+// results, so these jump to oom of aux on out of memory
+void *vsub_pool_malloc(Auxil *aux, size_t size);
+void *vsub_pool_realloc(Auxil *aux, void *ptr, size_t size);
+void vsub_pool_free(Auxil *aux, void *ptr);
+void vsub_pool_init(Auxil *aux);
+void vsub_pool_release(Auxil *aux);  // free all pooled memory
 
 
 // --- parser generator configuration
 
 // parser generator settings
 #define PCC_ERROR(auxil) { ((Vsub*)auxil->sub)->err = VSUB_ERR_SYNTAX; return 0; }
-#define PCC_GETCHAR(auxil) auxil->getchar(auxil)
+#define PCC_MALLOC(auxil, size) vsub_pool_malloc(auxil, size)
+#define PCC_REALLOC(auxil, ptr, size) vsub_pool_realloc(auxil, ptr, size)
+#define PCC_FREE(auxil, ptr) vsub_pool_free(auxil, ptr)
+#define PCC_GETCHAR(auxil) ((auxil)->inpi < (auxil)->inpn ? \
+    (int)(unsigned char)(auxil)->inp[(auxil)->inpi++] : (auxil)->getchar(auxil))
 
 
 // --- parser grammar helpers
 
 // todo: subst vs org -- totally messed up!
 
-// actions
-#define _use_Input    { auxil->append_orig(auxil, _0e, _0); }
-#define _use_Const(s) { auxil->append_orig(auxil, _0e, s); }
-#define _use_Value    { auxil->append_subst(auxil, _0e, __tmp); }
-#define _use_Other(s) { auxil->append_subst(auxil, _0e, s); }
-#define _use_Error(e) { auxil->append_error(auxil, _0e, __tmp, e); return 0; }
+// captures are viewed in parser buffer, which holds the whole atom until its
+// action returns, instead of zero terminated copies
+#define _span(s, e)   ((VsubSpan){__pcc_ctx->buffer.buf + (s) - __pcc_ctx->pos, (e) - (s)})
+#define SPAN(n)       _span(_##n##s, _##n##e)
+
+// actions; input bytes are copied as is, including zero bytes
+#define _epos         (auxil->base + _0e)
+#define _use_Input    { VsubSpan __in = SPAN(0); auxil->append_orig(auxil, _epos, __in.ptr, __in.len); }
+#define _use_Const(s) { auxil->append_orig(auxil, _epos, s, sizeof(s) - 1); }  // string literal
+#define _use_Value    { auxil->append_subst(auxil, _epos, __tmp, __len); }
+#define _use_Other(s) { auxil->append_subst(auxil, _epos, s, sizeof(s) - 1); }  // string literal
+#define _use_Error(e) { auxil->append_error(auxil, _epos, __tmp, e); return 0; }
 #define USE(a) _use_##a;
 
-// rules
-#define _get_Value(v)  const char *__tmp = auxil->getvalue(auxil, v)
-#define _if_Set(v)     _get_Value(v); if(__tmp != NULL)
-#define _if_Empty(v)   _get_Value(v); if(__tmp != NULL && strlen(__tmp) == 0)
-#define _if_Filled(v)  _get_Value(v); if(__tmp != NULL && strlen(__tmp) >= 1)
-#define _if_Missing(v) _get_Value(v); if(__tmp == NULL || strlen(__tmp) == 0)
+// rules; vars outside allowlist are kept as is, whatever the rule
+#define _get_Value(v)  size_t __len = 0; \
+                       const char *__tmp = auxil->getvalue(auxil, (v).ptr, (v).len, &__len); \
+                       if (__tmp == VSUB_VALUE_KEEP) _use_Input else
+#define _if_Set(v)     _get_Value(v) if(__tmp != NULL)
+#define _if_Empty(v)   _get_Value(v) if(__tmp != NULL && __len == 0)
+#define _if_Filled(v)  _get_Value(v) if(__tmp != NULL && __len >= 1)
+#define _if_Missing(v) _get_Value(v) if(__tmp == NULL || __len == 0)
 #define IF(s)   { _if_##s
 #define THEN(a) _use_##a
 #define ELSE(a) else _use_##a }
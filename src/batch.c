@@ -0,0 +1,244 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "aux.h"
+#include "vsub.h"
+#include "vsubio.h"
+
+
+// --- job queues
+
+typedef struct Batch Batch;
+
+// contiguous range of jobs owned by worker; owner takes jobs from the front,
+// idle workers steal half of the rest from the back
+typedef struct BatchWorker {
+    Batch *batch;
+    size_t id;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    size_t next;  // next job to run
+    size_t end;   // end of job range
+} BatchWorker;
+
+struct Batch {
+    const Vsub *params;
+    const VsubJob *jobs;
+    VsubJobResult *results;
+    BatchWorker *workers;
+    size_t workerc;
+};
+
+static bool batch_steal(BatchWorker *w, size_t *job) {
+    Batch *b = w->batch;
+    for (size_t k = 1; k < b->workerc; k++) {
+        BatchWorker *victim = &b->workers[(w->id + k) % b->workerc];
+        pthread_mutex_lock(&victim->lock);
+        size_t hi = victim->end;
+        size_t lo = hi - (hi - victim->next + 1) / 2;
+        victim->end = lo;
+        pthread_mutex_unlock(&victim->lock);
+        if (lo < hi) {
+            pthread_mutex_lock(&w->lock);
+            w->next = lo + 1;
+            w->end = hi;
+            pthread_mutex_unlock(&w->lock);
+            *job = lo;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool batch_take(BatchWorker *w, size_t *job) {
+    pthread_mutex_lock(&w->lock);
+    bool found = w->next < w->end;
+    if (found) {
+        *job = w->next++;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return found || batch_steal(w, job);
+}
+
+
+// --- jobs
+
+static bool batch_copy_results(const Vsub *sub, VsubJobResult *res) {
+    res->err = sub->err;
+    res->trunc = sub->trunc;
+    res->inpc = sub->inpc;
+    res->resc = sub->resc;
+    res->subc = sub->subc;
+    if (sub->res) {
+        if (!(res->res = malloc(sub->resc + 1))) {
+            return false;
+        }
+        memcpy(res->res, sub->res, sub->resc + 1);
+    }
+    if (sub->errvar && sub->errmsg) {
+        size_t varz = sub->errmsg - sub->errvar;
+        size_t msgz = strlen(sub->errmsg) + 1;
+        if (!(res->errvar = malloc(varz + msgz))) {
+            return false;
+        }
+        memcpy(res->errvar, sub->errvar, varz + msgz);
+        res->errmsg = res->errvar + varz;
+    }
+    return true;
+}
+
+static bool batch_input(Vsub *sub, const VsubJob *job, VsubJobResult *res, FILE **fp) {
+    if (job->text) {
+        return vsub_UseTextFromStr(sub, job->text);
+    }
+    if (!(*fp = fopen(job->path, "r"))) {
+        res->err = VSUB_ERR_FILE_OPEN;
+        return false;
+    }
+    // regular files are mapped, other inputs are streamed
+    return vsub_UseTextFromMmap(sub, fileno(*fp)) || vsub_UseTextFromFile(sub, *fp);
+}
+
+static bool batch_output(Vsub *sub, const VsubJob *job, VsubJobResult *res, int *fd) {
+    if (job->write) {
+        return vsub_UseSink(sub, job->write, job->data);
+    }
+    if (job->outpath) {
+        if ((*fd = open(job->outpath, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+            res->err = VSUB_ERR_FILE_WRITE;
+            return false;
+        }
+        return vsub_UseSinkFd(sub, *fd);
+    }
+    return true;
+}
+
+// sources are replaced, parser context and buffers of sub are reused
+static void batch_run(Vsub *sub, const VsubJob *job, VsubJobResult *res, const VsubVarTable **vars) {
+    if (job->vars != *vars) {
+        vsub_CloseVarsSrc(sub);
+        *vars = NULL;
+        if (job->vars && !vsub_UseVarsFromTable(sub, job->vars)) {
+            return;
+        }
+        *vars = job->vars;
+    }
+    FILE *fp = NULL;
+    int fd = -1;
+    if (batch_input(sub, job, res, &fp) && batch_output(sub, job, res, &fd)) {
+        vsub_run(sub);
+        if (!batch_copy_results(sub, res)) {
+            res->err = VSUB_ERR_MEMORY;
+        }
+    }
+    vsub_CloseTextSrc(sub);
+    vsub_CloseSink(sub);
+    if (fp) {
+        fclose(fp);
+    }
+    if (fd >= 0) {
+        if (close(fd) != 0 && res->err == VSUB_SUCCESS) {
+            res->err = VSUB_ERR_FILE_WRITE;
+        }
+        if (res->err != VSUB_SUCCESS) {
+            remove(job->outpath);
+        }
+    }
+}
+
+static void *batch_worker(BatchWorker *w) {
+    Batch *b = w->batch;
+    Vsub sub;
+    if (!vsub_init_like(&sub, b->params)) {
+        vsub_free(&sub);
+        return NULL;  // jobs are left to other workers
+    }
+    sub.syntax = b->params->syntax;
+    sub.engine = b->params->engine;
+    sub.depth = b->params->depth;
+    sub.only = b->params->only;
+    sub.maxinp = b->params->maxinp;
+    sub.maxres = b->params->maxres;
+    if (vsub_alloc(&sub)) {
+        const VsubVarTable *vars = NULL;
+        size_t job;
+        while (batch_take(w, &job)) {
+            batch_run(&sub, &b->jobs[job], &b->results[job], &vars);
+        }
+    }
+    vsub_free(&sub);
+    return NULL;
+}
+
+
+// --- vsub user api
+
+bool vsub_run_batch(const Vsub *sub, const VsubJob *jobs, VsubJobResult *results,
+    size_t count, size_t threads) {
+    for (size_t i = 0; i < count; i++) {
+        VsubJobResult *res = &results[i];
+        res->res = res->errvar = res->errmsg = NULL;
+        res->err = VSUB_ERR_MEMORY;
+        res->trunc = false;
+        res->inpc = res->resc = res->subc = 0;
+    }
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cpus > 0) ? (size_t)cpus : 1;
+    }
+    if (threads > count) {
+        threads = count;
+    }
+    if (threads == 0) {
+        return true;
+    }
+    Batch b = {.params = sub, .jobs = jobs, .results = results, .workerc = threads};
+    if (!(b.workers = malloc(threads * sizeof(BatchWorker)))) {
+        return false;
+    }
+    for (size_t i = 0; i < threads; i++) {
+        BatchWorker *w = &b.workers[i];
+        w->batch = &b;
+        w->id = i;
+        pthread_mutex_init(&w->lock, NULL);
+        w->next = count * i / threads;
+        w->end = count * (i + 1) / threads;
+    }
+    // calling thread is the first worker
+    bool *started = calloc(threads, sizeof(bool));
+    if (!started) {
+        threads = 1;
+    }
+    for (size_t i = 1; i < threads; i++) {
+        started[i] = pthread_create(&b.workers[i].thread, NULL, (void *(*)(void *))batch_worker,
+            &b.workers[i]) == 0;
+    }
+    batch_worker(&b.workers[0]);
+    for (size_t i = 1; i < threads; i++) {
+        if (started[i]) {
+            pthread_join(b.workers[i].thread, NULL);
+        }
+    }
+    for (size_t i = 0; i < b.workerc; i++) {
+        pthread_mutex_destroy(&b.workers[i].lock);
+    }
+    free(started);
+    free(b.workers);
+
+    bool ok = true;
+    for (size_t i = 0; i < count; i++) {
+        ok = ok && results[i].err == VSUB_SUCCESS;
+    }
+    return ok;
+}
+
+void vsub_free_batch(VsubJobResult *results, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(results[i].res);
+        free(results[i].errvar);  // errmsg is allocated with errvar
+        results[i].res = results[i].errvar = results[i].errmsg = NULL;
+    }
+}
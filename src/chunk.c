@@ -0,0 +1,184 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "aux.h"
+#include "vsubio.h"
+
+
+// --- chunk text source
+
+static const char *NAME = "chunk";
+
+// borrowed span of the input view
+typedef struct VsubTextChunk {
+    struct VsubTextSrc super;
+    const char *ptr;
+    size_t len;
+    size_t i;
+} VsubTextChunk;
+
+static size_t _read(VsubTextChunk *src, char *buf, size_t n) {
+    size_t left = src->len - src->i;
+    if (n > left) {
+        n = left;
+    }
+    memcpy(buf, src->ptr + src->i, n);
+    src->i += n;
+    return n;
+}
+
+static bool _view(VsubTextChunk *src, const char **ptr, size_t *len) {
+    *ptr = src->ptr + src->i;
+    *len = src->len - src->i;
+    src->i = src->len;
+    return true;
+}
+
+static bool chunk_use_text(Vsub *sub, const char *ptr, size_t len) {
+    VsubTextChunk *src = MEM_ALLOC(sub->alloc, sizeof(VsubTextChunk));
+    if (!src) {
+        return false;
+    }
+    ((VsubTextSrc *)src)->name = NAME;
+    ((VsubTextSrc *)src)->read = (size_t (*)(void *, char *, size_t))_read;
+    ((VsubTextSrc *)src)->view = (bool (*)(void *, const char **, size_t *))_view;
+    ((VsubTextSrc *)src)->reset = NULL;
+    ((VsubTextSrc *)src)->close = NULL;
+    src->ptr = ptr;
+    src->len = len;
+    src->i = 0;
+    vsub_SetTextSrc(sub, (VsubTextSrc *)src);
+    return true;
+}
+
+
+// --- chunks
+
+// atoms never contain newline, so input is split right after newlines; every
+// chunk is rendered by its own context, sharing var sources of the parent
+typedef struct Chunk {
+    Vsub sub;
+    size_t start;  // chunk offset in the input
+    pthread_t thread;
+    bool init;     // whether sub was initialized
+    bool started;  // whether thread was started
+    bool ok;
+} Chunk;
+
+static void *chunk_run(Chunk *c) {
+    c->ok = vsub_run(&c->sub);
+    return NULL;
+}
+
+// render the whole input in the calling thread
+static bool chunk_run_serial(Vsub *sub, const char *ptr, size_t len) {
+    void *tsrc = sub->tsrc;  // view of consumed source remains valid
+    sub->tsrc = NULL;
+    if (!chunk_use_text(sub, ptr, len)) {
+        sub->tsrc = tsrc;
+        sub->err = VSUB_ERR_MEMORY;
+        return false;
+    }
+    size_t threads = sub->threads;
+    bool trunc = sub->trunc;  // view was cut by maxinp, run state is cleared
+    sub->threads = 1;
+    bool ok = vsub_run(sub);
+    sub->threads = threads;
+    sub->trunc = sub->trunc || trunc;
+    vsub_CloseTextSrc(sub);
+    sub->tsrc = tsrc;
+    return ok;
+}
+
+static size_t chunk_split(Chunk *chunks, size_t n, const char *ptr, size_t len) {
+    size_t count = 0;
+    for (size_t start = 0, i = 1; start < len; i++) {
+        size_t pos = MAX(start, len / n * i);
+        const char *nl = (i < n) ? memchr(ptr + pos, '\n', len - pos) : NULL;
+        size_t end = nl ? (size_t)(nl - ptr) + 1 : len;
+        chunks[count++].start = start;
+        start = end;
+    }
+    return count;
+}
+
+static bool chunk_init(Chunk *c, const Vsub *sub, const char *ptr, size_t len) {
+    if (!(c->init = vsub_init_like(&c->sub, sub))) {
+        return false;
+    }
+    c->sub.syntax = sub->syntax;
+    c->sub.engine = sub->engine;
+    c->sub.depth = sub->depth;
+    c->sub.only = sub->only;
+    c->sub.vsrc = sub->vsrc;  // borrowed, lookups don't modify sources
+    return chunk_use_text(&c->sub, ptr + c->start, len) && vsub_alloc(&c->sub);
+}
+
+bool vsub_run_chunks(Vsub *sub, const char *ptr, size_t len) {
+    size_t threads = sub->threads;
+    if (threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cpus > 0) ? (size_t)cpus : 1;
+    }
+    size_t n = MIN(threads, len / VSUB_CHUNK_MIN);
+    Chunk *chunks = (n >= 2) ? MEM_ALLOC(sub->alloc, n * sizeof(Chunk)) : NULL;
+    if (!chunks) {
+        return chunk_run_serial(sub, ptr, len);
+    }
+    memset(chunks, 0, n * sizeof(Chunk));
+    if ((n = chunk_split(chunks, n, ptr, len)) < 2) {
+        MEM_FREE(sub->alloc, chunks);
+        return chunk_run_serial(sub, ptr, len);
+    }
+
+    // render chunks, calling thread takes the first one
+    bool ok = true;
+    for (size_t i = 0; i < n && ok; i++) {
+        size_t end = (i + 1 < n) ? chunks[i + 1].start : len;
+        ok = chunk_init(&chunks[i], sub, ptr, end - chunks[i].start);
+    }
+    for (size_t i = 1; i < n && ok; i++) {
+        Chunk *c = &chunks[i];
+        c->started = pthread_create(&c->thread, NULL, (void *(*)(void *))chunk_run, c) == 0;
+        if (!c->started) {
+            chunk_run(c);
+        }
+    }
+    if (ok) {
+        chunk_run(&chunks[0]);
+    }
+    for (size_t i = 1; i < n; i++) {
+        if (chunks[i].started) {
+            pthread_join(chunks[i].thread, NULL);
+        }
+    }
+    for (size_t i = 0; i < n && ok; i++) {
+        ok = chunks[i].ok;
+    }
+
+    // concatenate results in order
+    if (ok) {
+        Auxil *aux = sub->aux;
+        for (size_t i = 0; i < n && sub->err == VSUB_SUCCESS; i++) {
+            Vsub *csub = &chunks[i].sub;
+            aux->append_orig(aux, 0, csub->res, csub->resc);  // makes res non-NULL like serial run
+            sub->subc += csub->subc;
+            sub->inpc = chunks[i].start + csub->inpc;
+        }
+        ok = vsub_flush_results(sub);
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (chunks[i].init) {
+            chunks[i].sub.vsrc = NULL;
+            vsub_free(&chunks[i].sub);
+        }
+    }
+    MEM_FREE(sub->alloc, chunks);
+
+    // errors are reported exactly as without chunks
+    if (!ok && sub->err != VSUB_ERR_FILE_WRITE) {
+        return chunk_run_serial(sub, ptr, len);
+    }
+    return ok;
+}
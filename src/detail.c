@@ -73,6 +73,10 @@ bool vsub_add_details(cJSON *root, const Vsub *sub) {
         ADD_KEY(metric, value, StringReference(sub->syntax->name));
         ADD_KEY(metric, hint, StringReference(sub->syntax->title));
     }}
+    {METRIC("engine", "parsing engine", sub->engine) {
+        ADD_KEY(metric, value, StringReference(sub->engine->name));
+        ADD_KEY(metric, hint, StringReference(sub->engine->title));
+    }}
     {METRIC("tsrc", "input text source", sub->tsrc) {
         ADD_KEY(metric, value, StringReference(((VsubTextSrc*)(sub->tsrc))->name));
     }}
@@ -94,6 +98,12 @@ bool vsub_add_details(cJSON *root, const Vsub *sub) {
             ADD_KEY(metric, hint, String("unlimited"));
         }
     }}
+    {METRIC("threads", "max rendering threads", true) {
+        ADD_KEY(metric, value, Number(sub->threads));
+        if (sub->threads == 0) {
+            ADD_KEY(metric, hint, String("one per CPU"));
+        }
+    }}
     {METRIC("depth", "max allowed depth", true) {
         ADD_KEY(metric, value, Number(sub->depth));
         ADD_KEY(metric, hint, String(
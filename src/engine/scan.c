@@ -0,0 +1,292 @@
+#include <stdlib.h>
+#include <string.h>
+#if defined(__GNUC__) && defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "scan.h"
+
+
+#ifndef VSUB_SCAN_BLOCK
+#define VSUB_SCAN_BLOCK 65536  // initial input buffer size
+#endif
+
+
+// --- syntax rules
+
+// the only difference between supported grammars is the unset '$' var action
+typedef struct ScanRules {
+    bool keep_unset;  // keep original text of unset '$' var, or drop it
+} ScanRules;
+
+static const ScanRules RULES[] = {
+    {.keep_unset = false},  // 0 = VSUB_SX_COMPOSE243
+    {.keep_unset = true},   // 1 = VSUB_SX_ENVSUBST
+};
+
+
+// --- context
+
+struct vsub_en_scan_context_tag {
+    Auxil *auxil;
+    const char *buf;  // input window, either input buffer or text source view
+    size_t len;    // input window length
+    size_t cur;    // current parsing position in the input window
+    size_t pos;    // input position of the input window
+    bool eof;      // whether text source is exhausted
+    char *mem;     // input buffer
+    size_t max;    // input buffer size
+};
+
+vsub_en_scan_context_t *vsub_en_scan_create(Auxil *auxil) {
+    const VsubAllocator *alloc = auxil->sub->alloc;
+    vsub_en_scan_context_t *ctx = MEM_ALLOC(alloc, sizeof(vsub_en_scan_context_t));
+    if (!ctx) {
+        return NULL;
+    }
+    ctx->auxil = auxil;
+    ctx->mem = MEM_ALLOC(alloc, VSUB_SCAN_BLOCK);
+    ctx->max = VSUB_SCAN_BLOCK;
+    ctx->buf = ctx->mem;
+    ctx->len = ctx->cur = ctx->pos = 0;
+    ctx->eof = false;
+    if (!ctx->mem) {
+        vsub_en_scan_destroy(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+void vsub_en_scan_destroy(vsub_en_scan_context_t *ctx) {
+    if (ctx) {
+        const VsubAllocator *alloc = ctx->auxil->sub->alloc;
+        MEM_FREE(alloc, ctx->mem);
+        MEM_FREE(alloc, ctx);
+    }
+}
+
+
+// --- input buffer
+
+// make at least num bytes available at current position, if input allows;
+// drops consumed bytes, so pointers into the buffer are invalidated
+static size_t scan_refill(vsub_en_scan_context_t *ctx, size_t num) {
+    if (ctx->len - ctx->cur >= num || ctx->eof) {
+        return ctx->len - ctx->cur;
+    }
+    // drop consumed
+    memmove(ctx->mem, ctx->buf + ctx->cur, ctx->len - ctx->cur);
+    ctx->buf = ctx->mem;
+    ctx->len -= ctx->cur;
+    ctx->pos += ctx->cur;
+    ctx->cur = 0;
+    // grow
+    if (ctx->max < num) {
+        size_t sz = ctx->max;
+        while (sz < num) {
+            sz *= 2;
+        }
+        char *newmem = MEM_REALLOC(ctx->auxil->sub->alloc, ctx->mem, sz);
+        if (!newmem) {
+            ctx->auxil->sub->err = VSUB_ERR_MEMORY;
+            return ctx->len;
+        }
+        ctx->buf = ctx->mem = newmem;
+        ctx->max = sz;
+    }
+    // fill
+    while (ctx->len < num) {
+        size_t got = ctx->auxil->read(ctx->auxil, ctx->mem + ctx->len, ctx->max - ctx->len);
+        if (got == 0) {
+            ctx->eof = true;
+            break;
+        }
+        ctx->len += got;
+    }
+    return ctx->len;
+}
+
+// use the rest of the input in place, when text source allows
+static void scan_view(vsub_en_scan_context_t *ctx) {
+    const char *ptr;
+    size_t len;
+    if (ctx->cur == ctx->len && !ctx->eof && ctx->auxil->view(ctx->auxil, &ptr, &len)) {
+        ctx->pos += ctx->len;
+        ctx->buf = ptr;
+        ctx->len = len;
+        ctx->cur = 0;
+        ctx->eof = true;
+    }
+}
+
+// prepare for new input, positions start from zero
+static void scan_reset(vsub_en_scan_context_t *ctx) {
+    ctx->pos = 0;
+    ctx->buf = ctx->mem;
+    ctx->len = ctx->cur = 0;
+    ctx->eof = false;
+}
+
+
+// --- scanning
+
+// find first '$', any other byte is copied as is
+static size_t scan_dollar_at(const char *s, size_t n) {
+    size_t i = 0;
+#if defined(__GNUC__) && defined(__AVX2__)
+    const __m256i dollar32 = _mm256_set1_epi8('$');
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, dollar32));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+#if defined(__GNUC__) && (defined(__AVX2__) || defined(__SSE2__))
+    const __m128i dollar16 = _mm_set1_epi8('$');
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, dollar16));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        if (s[i] == '$') {
+            return i;
+        }
+    }
+    return n;
+}
+
+// length of var name at offset i from current position, or 0 if there is no var
+static size_t scan_name(vsub_en_scan_context_t *ctx, size_t i) {
+    size_t n = 0;
+    for (;;) {
+        if (scan_refill(ctx, i + n + 1) < i + n + 1) {
+            break;
+        }
+        char c = ctx->buf[ctx->cur + i + n];
+        if (!(c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+              (n > 0 && c >= '0' && c <= '9'))) {
+            break;
+        }
+        n++;
+    }
+    return n;
+}
+
+// parse atom starting with '$'
+static bool scan_dollar(vsub_en_scan_context_t *ctx, const ScanRules *rules) {
+    Auxil *aux = ctx->auxil;
+    size_t avail = scan_refill(ctx, 2);
+    // '$$'
+    if (avail >= 2 && ctx->buf[ctx->cur + 1] == '$') {
+        ctx->cur += 2;
+        aux->append_orig(aux, ctx->pos + ctx->cur, "$", 1);
+        return true;
+    }
+    // '${' var '}' or '$' var
+    bool braced = (avail >= 2 && ctx->buf[ctx->cur + 1] == '{');
+    size_t i = braced ? 2 : 1;
+    size_t n = scan_name(ctx, i);
+    if (n > 0 && braced) {
+        if (scan_refill(ctx, i + n + 1) < i + n + 1 || ctx->buf[ctx->cur + i + n] != '}') {
+            n = 0;
+        }
+    }
+    // '$' alone
+    if (n == 0) {
+        ctx->cur += 1;
+        aux->append_orig(aux, ctx->pos + ctx->cur, "$", 1);
+        return true;
+    }
+    // variable, name is looked up in place
+    const char *start = ctx->buf + ctx->cur;
+    size_t len = i + n + (braced ? 1 : 0);
+    ctx->cur += len;
+    size_t vlen;
+    const char *value = aux->getvalue(aux, start + i, n, &vlen);
+    if (value == VSUB_VALUE_KEEP) {
+        aux->append_orig(aux, ctx->pos + ctx->cur, start, len);
+    }
+    else if (value) {
+        aux->append_subst(aux, ctx->pos + ctx->cur, value, vlen);
+    }
+    else if (braced || rules->keep_unset) {
+        aux->append_orig(aux, ctx->pos + ctx->cur, start, len);
+    }
+    else {
+        aux->append_orig(aux, ctx->pos + ctx->cur, "", 0);
+    }
+    return true;
+}
+
+// var references are found without rendering, like atoms in parse
+bool vsub_en_scan_refs(vsub_en_scan_context_t *ctx, VsubRefFn fn, void *data) {
+    Vsub *sub = ctx->auxil->sub;
+    scan_reset(ctx);
+    scan_view(ctx);
+    while (sub->err == VSUB_SUCCESS && scan_refill(ctx, 1) >= 1) {
+        ctx->cur += scan_dollar_at(ctx->buf + ctx->cur, ctx->len - ctx->cur);
+        if (ctx->cur == ctx->len) {
+            continue;
+        }
+        size_t avail = scan_refill(ctx, 2);
+        // '$$'
+        if (avail >= 2 && ctx->buf[ctx->cur + 1] == '$') {
+            ctx->cur += 2;
+            continue;
+        }
+        // '${' var '}' or '$' var
+        bool braced = (avail >= 2 && ctx->buf[ctx->cur + 1] == '{');
+        size_t i = braced ? 2 : 1;
+        size_t n = scan_name(ctx, i);
+        if (n > 0 && braced) {
+            if (scan_refill(ctx, i + n + 1) < i + n + 1 || ctx->buf[ctx->cur + i + n] != '}') {
+                n = 0;
+            }
+        }
+        if (n == 0) {
+            ctx->cur += 1;
+            continue;
+        }
+        if (!fn(data, ctx->buf + ctx->cur + i, n, ctx->pos + ctx->cur)) {
+            return false;
+        }
+        ctx->cur += i + n + (braced ? 1 : 0);
+    }
+    return sub->err == VSUB_SUCCESS;
+}
+
+int vsub_en_scan_parse(vsub_en_scan_context_t *ctx, const char **ret) {
+    (void)ret;  // no parse value, results are appended by auxil
+    Auxil *aux = ctx->auxil;
+    Vsub *sub = aux->sub;
+    const ScanRules *rules = &RULES[sub->syntax->id];
+    scan_reset(ctx);  // whole input is parsed in one call
+    scan_view(ctx);
+    if (scan_refill(ctx, 1) < 1) {
+        return 0;
+    }
+    size_t start = ctx->cur;  // literal run start
+    while (sub->err == VSUB_SUCCESS) {
+        // extend literal run
+        ctx->cur += scan_dollar_at(ctx->buf + ctx->cur, ctx->len - ctx->cur);
+        // flush literal run
+        if (ctx->cur > start) {
+            aux->append_orig(aux, ctx->pos + ctx->cur, ctx->buf + start, ctx->cur - start);
+        }
+        if (scan_refill(ctx, 1) < 1) {
+            break;  // all consumed
+        }
+        if (ctx->buf[ctx->cur] == '$' && !scan_dollar(ctx, rules)) {
+            return 0;
+        }
+        start = ctx->cur;
+    }
+    return 0;  // nothing left for the next call
+}
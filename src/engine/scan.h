@@ -0,0 +1,19 @@
+#ifndef VSUB_ENGINE_SCAN_H
+#define VSUB_ENGINE_SCAN_H
+
+#include "../aux.h"
+
+
+// hand-written scanning parser; implements VsubParser for every syntax
+
+typedef struct vsub_en_scan_context_tag vsub_en_scan_context_t;
+
+vsub_en_scan_context_t *vsub_en_scan_create(Auxil *auxil);
+int vsub_en_scan_parse(vsub_en_scan_context_t *ctx, const char **ret);
+// call fn for every var reference of the whole input; false on error
+typedef bool (*VsubRefFn)(void *data, const char *name, size_t len, size_t pos);
+bool vsub_en_scan_refs(vsub_en_scan_context_t *ctx, VsubRefFn fn, void *data);
+void vsub_en_scan_destroy(vsub_en_scan_context_t *ctx);
+
+
+#endif  // VSUB_ENGINE_SCAN_H
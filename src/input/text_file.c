@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include "../util.h"
 #include "../vsubio.h"
 
 
@@ -11,27 +12,47 @@ typedef struct VsubTextFile {
     bool eof;
 } VsubTextFile;
 
-static int _getchar(VsubTextFile *src) {
+static size_t _read(VsubTextFile *src, char *buf, size_t n) {
     if (src->eof) {  // after EOF reached
-        return -1;
+        return 0;
     }
-    char c = fgetc(src->fp);
-    if (c < 0) {  // EOF reached
+    size_t got = fread(buf, 1, n, src->fp);
+    if (got < n) {  // EOF reached or read error
         src->eof = true;
-        return -1;
     }
-    return (int)c;
+    return got;
+}
+
+static bool _reset(VsubTextFile *src) {
+    if (fseek(src->fp, 0, SEEK_SET) != 0) {  // not seekable
+        return false;
+    }
+    src->eof = false;
+    return true;
 }
 
 bool vsub_UseTextFromFile(Vsub *sub, FILE *fp) {
-    VsubTextFile *src = malloc(sizeof(VsubTextFile));
+    VsubTextFile *src = MEM_ALLOC(sub->alloc, sizeof(VsubTextFile));
     if (!src) {
         return false;
     }
     ((VsubTextSrc *)src)->name = NAME;
-    ((VsubTextSrc *)src)->getchar = (int (*)(void *))_getchar;
+    ((VsubTextSrc *)src)->read = (size_t (*)(void *, char *, size_t))_read;
+    ((VsubTextSrc *)src)->view = NULL;
+    ((VsubTextSrc *)src)->reset = (bool (*)(void *))_reset;
+    ((VsubTextSrc *)src)->close = NULL;
     src->fp = fp;
     src->eof = false;
     vsub_SetTextSrc(sub, (VsubTextSrc *)src);
     return true;
 }
+
+bool vsub_SetTextFromFile(Vsub *sub, FILE *fp) {
+    VsubTextFile *src = sub->tsrc;
+    if (!src || ((VsubTextSrc *)src)->name != NAME) {
+        return vsub_UseTextFromFile(sub, fp);
+    }
+    src->fp = fp;
+    src->eof = false;
+    return true;
+}
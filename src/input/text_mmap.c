@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../util.h"
+#include "../vsubio.h"
+
+
+static const char *NAME = "mmap";
+
+typedef struct VsubTextMmap {
+    struct VsubTextSrc super;
+    char *map;
+    size_t len;
+    size_t i;
+} VsubTextMmap;
+
+static size_t _read(VsubTextMmap *src, char *buf, size_t n) {
+    size_t left = src->len - src->i;
+    if (n > left) {
+        n = left;
+    }
+    memcpy(buf, src->map + src->i, n);
+    src->i += n;
+    return n;
+}
+
+static bool _view(VsubTextMmap *src, const char **ptr, size_t *len) {
+    *ptr = src->map + src->i;
+    *len = src->len - src->i;
+    src->i = src->len;
+    return true;
+}
+
+static bool _reset(VsubTextMmap *src) {
+    src->i = 0;
+    return true;
+}
+
+static void _close(VsubTextMmap *src) {
+    if (src->map) {
+        munmap(src->map, src->len);
+    }
+}
+
+bool vsub_UseTextFromMmap(Vsub *sub, int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    char *map = NULL;
+    if (st.st_size > 0) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            return false;
+        }
+        posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+    }
+    VsubTextMmap *src = MEM_ALLOC(sub->alloc, sizeof(VsubTextMmap));
+    if (!src) {
+        if (map) {
+            munmap(map, st.st_size);
+        }
+        return false;
+    }
+    ((VsubTextSrc *)src)->name = NAME;
+    ((VsubTextSrc *)src)->read = (size_t (*)(void *, char *, size_t))_read;
+    ((VsubTextSrc *)src)->view = (bool (*)(void *, const char **, size_t *))_view;
+    ((VsubTextSrc *)src)->reset = (bool (*)(void *))_reset;
+    ((VsubTextSrc *)src)->close = (void (*)(void *))_close;
+    src->map = map;
+    src->len = st.st_size;
+    src->i = 0;
+    vsub_SetTextSrc(sub, (VsubTextSrc *)src);
+    return true;
+}
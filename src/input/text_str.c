@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <string.h>
+#include "../util.h"
 #include "../vsubio.h"
 
 
@@ -12,23 +13,60 @@ typedef struct VsubTextStr {
     size_t i;
 } VsubTextStr;
 
-static int _getchar(VsubTextStr *src) {
-    if (src->i >= src->len - 1) {
-        return -1;
+static size_t _read(VsubTextStr *src, char *buf, size_t n) {
+    size_t left = src->len - src->i;
+    if (n > left) {
+        n = left;
     }
-    return (int)src->str[src->i++];
+    memcpy(buf, src->str + src->i, n);
+    src->i += n;
+    return n;
 }
 
-bool vsub_UseTextFromStr(Vsub *sub, const char *s) {
-    VsubTextStr *src = malloc(sizeof(VsubTextStr));
+static bool _view(VsubTextStr *src, const char **ptr, size_t *len) {
+    *ptr = src->str + src->i;
+    *len = src->len - src->i;
+    src->i = src->len;
+    return true;
+}
+
+static bool _reset(VsubTextStr *src) {
+    src->i = 0;
+    return true;
+}
+
+bool vsub_UseTextFromBuf(Vsub *sub, const char *ptr, size_t len) {
+    VsubTextStr *src = MEM_ALLOC(sub->alloc, sizeof(VsubTextStr));
     if (!src) {
         return false;
     }
     ((VsubTextSrc *)src)->name = NAME;
-    ((VsubTextSrc *)src)->getchar = (int (*)(void *))_getchar;
-    src->str = s;
-    src->len = strlen(s);
+    ((VsubTextSrc *)src)->read = (size_t (*)(void *, char *, size_t))_read;
+    ((VsubTextSrc *)src)->view = (bool (*)(void *, const char **, size_t *))_view;
+    ((VsubTextSrc *)src)->reset = (bool (*)(void *))_reset;
+    ((VsubTextSrc *)src)->close = NULL;
+    src->str = ptr;
+    src->len = len;
     src->i = 0;
     vsub_SetTextSrc(sub, (VsubTextSrc *)src);
     return true;
 }
+
+bool vsub_SetTextFromBuf(Vsub *sub, const char *ptr, size_t len) {
+    VsubTextStr *src = sub->tsrc;
+    if (!src || ((VsubTextSrc *)src)->name != NAME) {
+        return vsub_UseTextFromBuf(sub, ptr, len);
+    }
+    src->str = ptr;
+    src->len = len;
+    src->i = 0;
+    return true;
+}
+
+bool vsub_UseTextFromStr(Vsub *sub, const char *s) {
+    return vsub_UseTextFromBuf(sub, s, strlen(s));
+}
+
+bool vsub_SetTextFromStr(Vsub *sub, const char *s) {
+    return vsub_SetTextFromBuf(sub, s, strlen(s));
+}
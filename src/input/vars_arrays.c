@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <string.h>
+#include "../util.h"
 #include "../vsubio.h"
 
 
@@ -7,30 +8,52 @@ static const char *NAME = "arrays";
 
 typedef struct VsubVarsArrays {
     struct VsubVarsSrc super;
-    const char **keys;
-    const char **vals;
-    int count;
+    StrMap index;  // key -> value, first occurrence wins
 } VsubVarsArrays;
 
-static const char *_getvalue(VsubVarsArrays *src, const char *var) {
-    for (int i = 0; i < src->count; i++) {
-        if (strcmp(var, src->keys[i]) == 0) {
-            return src->vals[i];
+static const char *_getvalue(VsubVarsArrays *src, const char *var, size_t len, size_t *vlen) {
+    StrMapItem *item = map_find(&src->index, var, len, hash_str(var, len));
+    *vlen = item ? item->vlen : 0;
+    return item ? item->val : NULL;
+}
+
+static bool _each(VsubVarsArrays *src, VsubVarFn fn, void *data) {
+    for (size_t i = 0; i < src->index.avail; i++) {
+        StrMapItem *item = &src->index.items[i];
+        if (item->key && !fn(data, item->key, item->klen, item->val, item->vlen)) {
+            return false;
         }
     }
-    return NULL;
+    return true;
+}
+
+static void _close(VsubVarsArrays *src) {
+    map_free(&src->index);
 }
 
 bool vsub_UseVarsFromArrays(Vsub *sub, size_t c, const char *k[], const char *v[]) {
-    VsubVarsArrays *src = malloc(sizeof(VsubVarsArrays));
+    VsubVarsArrays *src = MEM_ALLOC(sub->alloc, sizeof(VsubVarsArrays));
     if (!src) {
         return false;
     }
     ((VsubVarsSrc *)src)->name = NAME;
-    ((VsubVarsSrc *)src)->getvalue = (const char *(*)(void *, const char *))_getvalue;
-    src->keys = k;
-    src->vals = v;
-    src->count = c;
+    ((VsubVarsSrc *)src)->getvalue = (const char *(*)(void *, const char *, size_t, size_t *))_getvalue;
+    ((VsubVarsSrc *)src)->each = (bool (*)(void *, VsubVarFn, void *))_each;
+    ((VsubVarsSrc *)src)->close = (void (*)(void *))_close;
+    map_init(&src->index, sub->alloc);
+    if (!map_realloc(&src->index, c)) {
+        MEM_FREE(sub->alloc, src);
+        return false;
+    }
+    for (size_t i = 0; i < c; i++) {
+        size_t klen = strlen(k[i]);
+        bool found;
+        StrMapItem *item = map_insert(&src->index, k[i], klen, hash_str(k[i], klen), &found);
+        if (!found) {
+            item->val = v[i];
+            item->vlen = strlen(v[i]);
+        }
+    }
     vsub_AddVarsSrc(sub, (VsubVarsSrc *)src);
     return true;
 }
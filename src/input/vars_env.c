@@ -1,24 +1,38 @@
 #include <stdlib.h>
+#include <string.h>
+#include "../util.h"
 #include "../vsubio.h"
 
 
+extern char **environ;
+
+
 static const char *NAME = "env";
 
 typedef struct VsubVarsEnv {
     struct VsubVarsSrc super;
 } VsubVarsEnv;
 
-static const char *_getvalue(VsubVarsEnv *src, const char *var) {
-    return getenv(var);
+// same search as getenv, which takes zero terminated names only
+static const char *_getvalue(VsubVarsEnv *src, const char *var, size_t len, size_t *vlen) {
+    for (char **kv = environ; *kv; kv++) {
+        if (strncmp(*kv, var, len) == 0 && (*kv)[len] == '=') {
+            *vlen = strlen(*kv + len + 1);  // environment may change, so it isn't indexed
+            return *kv + len + 1;
+        }
+    }
+    return NULL;
 }
 
 bool vsub_UseVarsFromEnv(Vsub *sub) {
-    VsubVarsEnv *src = malloc(sizeof(VsubVarsEnv));
+    VsubVarsEnv *src = MEM_ALLOC(sub->alloc, sizeof(VsubVarsEnv));
     if (!src) {
         return false;
     }
     ((VsubVarsSrc *)src)->name = NAME;
-    ((VsubVarsSrc *)src)->getvalue = (const char *(*)(void *, const char *))_getvalue;
+    ((VsubVarsSrc *)src)->getvalue = (const char *(*)(void *, const char *, size_t, size_t *))_getvalue;
+    ((VsubVarsSrc *)src)->each = NULL;  // not merged or shared, see _getvalue
+    ((VsubVarsSrc *)src)->close = NULL;
     vsub_AddVarsSrc(sub, (VsubVarsSrc *)src);
     return true;
 }
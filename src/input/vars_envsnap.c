@@ -0,0 +1,89 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../util.h"
+#include "../vsubio.h"
+
+
+extern char **environ;
+
+
+static const char *NAME = "envsnap";
+
+// copy of environment taken when the source is attached
+typedef struct VsubVarsEnvsnap {
+    struct VsubVarsSrc super;
+    char *data;    // zero terminated 'key=value' items
+    StrMap index;  // key -> value, first occurrence wins like in getenv
+} VsubVarsEnvsnap;
+
+static const char *_getvalue(VsubVarsEnvsnap *src, const char *var, size_t len, size_t *vlen) {
+    StrMapItem *item = map_find(&src->index, var, len, hash_str(var, len));
+    *vlen = item ? item->vlen : 0;
+    return item ? item->val : NULL;
+}
+
+static bool _each(VsubVarsEnvsnap *src, VsubVarFn fn, void *data) {
+    for (size_t i = 0; i < src->index.avail; i++) {
+        StrMapItem *item = &src->index.items[i];
+        if (item->key && !fn(data, item->key, item->klen, item->val, item->vlen)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void _close(VsubVarsEnvsnap *src) {
+    map_free(&src->index);
+    MEM_FREE(src->index.alloc, src->data);
+}
+
+static bool _matches(const char *kv, const char *prefix, size_t plen) {
+    return strncmp(kv, prefix, plen) == 0 && strchr(kv, '=');
+}
+
+bool vsub_UseVarsFromEnvSnapshot(Vsub *sub, const char *prefix) {
+    size_t plen = prefix ? strlen(prefix) : 0;
+    prefix = prefix ? prefix : "";
+    // measure
+    size_t count = 0, size = 0;
+    for (char **kv = environ; *kv; kv++) {
+        if (_matches(*kv, prefix, plen)) {
+            count++;
+            size += strlen(*kv) + 1;
+        }
+    }
+    // copy and index
+    VsubVarsEnvsnap *src = MEM_ALLOC(sub->alloc, sizeof(VsubVarsEnvsnap));
+    if (!src) {
+        return false;
+    }
+    map_init(&src->index, sub->alloc);
+    src->data = MEM_ALLOC(sub->alloc, size ? size : 1);
+    if (!src->data || !map_realloc(&src->index, count)) {
+        _close(src);
+        MEM_FREE(sub->alloc, src);
+        return false;
+    }
+    char *pos = src->data;
+    for (char **kv = environ; *kv; kv++) {
+        if (!_matches(*kv, prefix, plen)) {
+            continue;
+        }
+        size_t len = strlen(*kv);
+        memcpy(pos, *kv, len + 1);
+        size_t klen = strchr(pos, '=') - pos;
+        bool found;
+        StrMapItem *item = map_insert(&src->index, pos, klen, hash_str(pos, klen), &found);
+        if (!found) {
+            item->val = pos + klen + 1;
+            item->vlen = len - klen - 1;
+        }
+        pos += len + 1;
+    }
+    ((VsubVarsSrc *)src)->name = NAME;
+    ((VsubVarsSrc *)src)->getvalue = (const char *(*)(void *, const char *, size_t, size_t *))_getvalue;
+    ((VsubVarsSrc *)src)->each = (bool (*)(void *, VsubVarFn, void *))_each;
+    ((VsubVarsSrc *)src)->close = (void (*)(void *))_close;
+    vsub_AddVarsSrc(sub, (VsubVarsSrc *)src);
+    return true;
+}
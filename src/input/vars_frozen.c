@@ -0,0 +1,135 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../util.h"
+#include "../vsubio.h"
+
+
+static const char *NAME = "frozen";
+
+// immutable union of consecutive enumerable sources, each var resolved by priority;
+// owns copies of all keys and values, as merged sources are closed
+typedef struct VsubVarsFrozen {
+    struct VsubVarsSrc super;
+    StrMap index;  // key -> value of the source with the highest priority
+    char *data;    // zero terminated keys and values
+} VsubVarsFrozen;
+
+static const char *_getvalue(VsubVarsFrozen *src, const char *var, size_t len, size_t *vlen) {
+    StrMapItem *item = map_find(&src->index, var, len, hash_str(var, len));
+    *vlen = item ? item->vlen : 0;
+    return item ? item->val : NULL;
+}
+
+static bool _each(VsubVarsFrozen *src, VsubVarFn fn, void *data) {
+    for (size_t i = 0; i < src->index.avail; i++) {
+        StrMapItem *item = &src->index.items[i];
+        if (item->key && !fn(data, item->key, item->klen, item->val, item->vlen)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void _close(VsubVarsFrozen *src) {
+    map_free(&src->index);
+    MEM_FREE(src->index.alloc, src->data);
+}
+
+// sources are merged from higher to lower priority, so existing keys are kept
+static bool _add(VsubVarsFrozen *src, const char *key, size_t klen, const char *val, size_t vlen) {
+    bool found;
+    StrMapItem *item = map_insert(&src->index, key, klen, hash_str(key, klen), &found);
+    if (!item) {
+        return false;
+    }
+    if (!found) {
+        item->val = val;
+        item->vlen = vlen;
+    }
+    return true;
+}
+
+static VsubVarsFrozen *frozen_create(Vsub *sub) {
+    VsubVarsFrozen *src = MEM_ALLOC(sub->alloc, sizeof(VsubVarsFrozen));
+    if (!src) {
+        return NULL;
+    }
+    ((VsubVarsSrc *)src)->name = NAME;
+    ((VsubVarsSrc *)src)->getvalue = (const char *(*)(void *, const char *, size_t, size_t *))_getvalue;
+    ((VsubVarsSrc *)src)->each = (bool (*)(void *, VsubVarFn, void *))_each;
+    ((VsubVarsSrc *)src)->close = (void (*)(void *))_close;
+    ((VsubVarsSrc *)src)->prev = NULL;
+    map_init(&src->index, sub->alloc);
+    src->data = NULL;
+    return src;
+}
+
+// replace strings owned by merged sources with copies
+static bool frozen_copy(VsubVarsFrozen *src) {
+    size_t size = 0;
+    for (size_t i = 0; i < src->index.avail; i++) {
+        StrMapItem *item = &src->index.items[i];
+        if (item->key) {
+            size += item->klen + item->vlen + 2;
+        }
+    }
+    if (!(src->data = MEM_ALLOC(src->index.alloc, size ? size : 1))) {
+        return false;
+    }
+    char *pos = src->data;
+    for (size_t i = 0; i < src->index.avail; i++) {
+        StrMapItem *item = &src->index.items[i];
+        if (item->key) {
+            memcpy(pos, item->key, item->klen);
+            pos[item->klen] = '\0';
+            item->key = pos;
+            pos += item->klen + 1;
+            memcpy(pos, item->val, item->vlen);
+            pos[item->vlen] = '\0';
+            item->val = pos;
+            pos += item->vlen + 1;
+        }
+    }
+    return true;
+}
+
+bool vsub_FreezeVars(Vsub *sub) {
+    VsubVarsSrc **link = (VsubVarsSrc **)&sub->vsrc;
+    while (*link) {
+        // sources that can't be enumerated stay in chain as is
+        if (!(*link)->each) {
+            link = (VsubVarsSrc **)&(*link)->prev;
+            continue;
+        }
+        // merge consecutive enumerable sources
+        VsubVarsFrozen *frz = frozen_create(sub);
+        if (!frz) {
+            return false;
+        }
+        VsubVarsSrc *end = *link;
+        bool ok = true;
+        while (ok && end && end->each) {
+            ok = end->each(end, (VsubVarFn)_add, frz);
+            end = end->prev;
+        }
+        if (!ok || !frozen_copy(frz)) {
+            _close(frz);
+            MEM_FREE(sub->alloc, frz);
+            return false;
+        }
+        // replace merged sources
+        VsubVarsSrc *src = *link;
+        while (src != end) {
+            VsubVarsSrc *prev = src->prev;
+            if (src->close) {
+                src->close(src);
+            }
+            MEM_FREE(sub->alloc, src);
+            src = prev;
+        }
+        ((VsubVarsSrc *)frz)->prev = end;
+        *link = (VsubVarsSrc *)frz;
+        link = (VsubVarsSrc **)&((VsubVarsSrc *)frz)->prev;
+    }
+    return true;
+}
@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <string.h>
+#include "../util.h"
 #include "../vsubio.h"
 
 
@@ -7,29 +8,56 @@ static const char *NAME = "kvarray";
 
 typedef struct VsubVarsKvarray {
     struct VsubVarsSrc super;
-    const char **kv;
-    int count;
+    StrMap index;  // key -> value, first occurrence wins
 } VsubVarsKvarray;
 
-static const char *_getvalue(VsubVarsKvarray *src, const char *var) {
-    size_t len = strlen(var);
-    for (int i = 0; i < src->count; i++) {
-        if (strncmp(var, src->kv[i], len) == 0 && src->kv[i][len] == '=') {
-            return &(src->kv[i][len + 1]);
+static const char *_getvalue(VsubVarsKvarray *src, const char *var, size_t len, size_t *vlen) {
+    StrMapItem *item = map_find(&src->index, var, len, hash_str(var, len));
+    *vlen = item ? item->vlen : 0;
+    return item ? item->val : NULL;
+}
+
+static bool _each(VsubVarsKvarray *src, VsubVarFn fn, void *data) {
+    for (size_t i = 0; i < src->index.avail; i++) {
+        StrMapItem *item = &src->index.items[i];
+        if (item->key && !fn(data, item->key, item->klen, item->val, item->vlen)) {
+            return false;
         }
     }
-    return NULL;
+    return true;
+}
+
+static void _close(VsubVarsKvarray *src) {
+    map_free(&src->index);
 }
 
 bool vsub_UseVarsFromKvarray(Vsub *sub, size_t c, const char *kv[]) {
-    VsubVarsKvarray *src = malloc(sizeof(VsubVarsKvarray));
+    VsubVarsKvarray *src = MEM_ALLOC(sub->alloc, sizeof(VsubVarsKvarray));
     if (!src) {
         return false;
     }
     ((VsubVarsSrc *)src)->name = NAME;
-    ((VsubVarsSrc *)src)->getvalue = (const char *(*)(void *, const char *))_getvalue;
-    src->kv = kv;
-    src->count = c;
+    ((VsubVarsSrc *)src)->getvalue = (const char *(*)(void *, const char *, size_t, size_t *))_getvalue;
+    ((VsubVarsSrc *)src)->each = (bool (*)(void *, VsubVarFn, void *))_each;
+    ((VsubVarsSrc *)src)->close = (void (*)(void *))_close;
+    map_init(&src->index, sub->alloc);
+    if (!map_realloc(&src->index, c)) {
+        MEM_FREE(sub->alloc, src);
+        return false;
+    }
+    for (size_t i = 0; i < c; i++) {
+        const char *eq = strchr(kv[i], '=');
+        if (!eq) {
+            continue;  // never matched
+        }
+        size_t klen = eq - kv[i];
+        bool found;
+        StrMapItem *item = map_insert(&src->index, kv[i], klen, hash_str(kv[i], klen), &found);
+        if (!found) {
+            item->val = eq + 1;
+            item->vlen = strlen(eq + 1);
+        }
+    }
     vsub_AddVarsSrc(sub, (VsubVarsSrc *)src);
     return true;
 }
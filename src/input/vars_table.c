@@ -0,0 +1,117 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../util.h"
+#include "../vsubio.h"
+
+
+static const char *NAME = "table";
+
+// immutable var table, owns copies of all keys and values
+struct VsubVarTable {
+    StrMap index;  // key -> value of the source with the highest priority
+    char *data;    // zero terminated keys and values
+};
+
+typedef struct VsubVarsTable {
+    struct VsubVarsSrc super;
+    const VsubVarTable *table;  // borrowed
+} VsubVarsTable;
+
+static const char *_getvalue(VsubVarsTable *src, const char *var, size_t len, size_t *vlen) {
+    StrMapItem *item = map_find(&src->table->index, var, len, hash_str(var, len));
+    *vlen = item ? item->vlen : 0;
+    return item ? item->val : NULL;
+}
+
+static bool _each(VsubVarsTable *src, VsubVarFn fn, void *data) {
+    const StrMap *index = &src->table->index;
+    for (size_t i = 0; i < index->avail; i++) {
+        StrMapItem *item = &index->items[i];
+        if (item->key && !fn(data, item->key, item->klen, item->val, item->vlen)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool vsub_UseVarsFromTable(Vsub *sub, const VsubVarTable *table) {
+    VsubVarsTable *src = MEM_ALLOC(sub->alloc, sizeof(VsubVarsTable));
+    if (!src) {
+        return false;
+    }
+    ((VsubVarsSrc *)src)->name = NAME;
+    ((VsubVarsSrc *)src)->getvalue = (const char *(*)(void *, const char *, size_t, size_t *))_getvalue;
+    ((VsubVarsSrc *)src)->each = (bool (*)(void *, VsubVarFn, void *))_each;
+    ((VsubVarsSrc *)src)->close = NULL;
+    src->table = table;
+    vsub_AddVarsSrc(sub, (VsubVarsSrc *)src);
+    return true;
+}
+
+
+// --- table construction
+
+// sources are added from higher to lower priority, so existing keys are kept
+static bool _add(VsubVarTable *table, const char *key, size_t klen, const char *val, size_t vlen) {
+    bool found;
+    StrMapItem *item = map_insert(&table->index, key, klen, hash_str(key, klen), &found);
+    if (!item) {
+        return false;
+    }
+    if (!found) {
+        item->val = val;
+        item->vlen = vlen;
+    }
+    return true;
+}
+
+VsubVarTable *vsub_ShareVars(Vsub *sub) {
+    VsubVarTable *table = malloc(sizeof(VsubVarTable));
+    if (!table) {
+        return NULL;
+    }
+    map_init(&table->index, &VSUB_ALLOC_LIBC);
+    table->data = NULL;
+    // index strings owned by sources
+    for (VsubVarsSrc *src = sub->vsrc; src; src = src->prev) {
+        if (src->each && !src->each(src, (VsubVarFn)_add, table)) {
+            vsub_FreeVarTable(table);
+            return NULL;
+        }
+    }
+    // copy strings
+    size_t size = 0;
+    for (size_t i = 0; i < table->index.avail; i++) {
+        StrMapItem *item = &table->index.items[i];
+        if (item->key) {
+            size += item->klen + item->vlen + 2;
+        }
+    }
+    if (!(table->data = malloc(size ? size : 1))) {
+        vsub_FreeVarTable(table);
+        return NULL;
+    }
+    char *pos = table->data;
+    for (size_t i = 0; i < table->index.avail; i++) {
+        StrMapItem *item = &table->index.items[i];
+        if (item->key) {
+            memcpy(pos, item->key, item->klen);
+            pos[item->klen] = '\0';
+            item->key = pos;
+            pos += item->klen + 1;
+            memcpy(pos, item->val, item->vlen);
+            pos[item->vlen] = '\0';
+            item->val = pos;
+            pos += item->vlen + 1;
+        }
+    }
+    return table;
+}
+
+void vsub_FreeVarTable(VsubVarTable *table) {
+    if (table) {
+        map_free(&table->index);
+        free(table->data);
+        free(table);
+    }
+}
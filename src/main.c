@@ -3,6 +3,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "vsub.h"
 #include "util.h"
 
@@ -37,52 +39,364 @@ static void print_syntaxes() {
 
 static void print_usage() {
     puts(
-        "usage: vsub [options] [path]\n"
+        "usage: vsub [options] [path...]\n"
         "  options:\n"
         "    -e, --env         use environment variables\n"
+        "        --engine=STR  set parsing engine; default: scan\n"
         "    -f, --format=STR  set output format; default: pretty if -d else plain\n"
         "    -d, --detailed    add extended details\n"
         "    -s, --syntax=STR  set syntax to use; default: envsubst\n"
         "    -v, --var=KEY=VAL set substitution variable; takes highest priority\n"
+        "    -j, --jobs=N      render with N threads, 0 for one per CPU; default: 1\n"
+        "        --list-vars   list referenced vars with count and first offset instead of rendering\n"
+        "        --only=LIST   substitute only vars in comma separated LIST, keep others as is\n"
+        "        --only-from=PATH  substitute only vars listed in PATH\n"
         "        --formats     list supported output formats\n"
         "        --syntaxes    list supported syntaxes\n"
         "        --version     show tool name and version\n"
-        "    -h, --help        show this help and exit"
+        "    -h, --help        show this help and exit\n"
+        "  output files:\n"
+        "        --output-dir=DIR  write output files to DIR instead of input file dir\n"
+        "        --suffix=STR  append STR to output file names\n"
+        "        --manifest=PATH   render 'input<TAB>output' path pairs listed in PATH"
     );
 }
 
 #define VSUB_OPT_VERSION 1000
 #define VSUB_OPT_FORMATS 1001
 #define VSUB_OPT_SYNTAXES 1002
+#define VSUB_OPT_ENGINE 1003
+#define VSUB_OPT_OUTPUT_DIR 1004
+#define VSUB_OPT_SUFFIX 1005
+#define VSUB_OPT_MANIFEST 1006
+#define VSUB_OPT_LIST_VARS 1007
+#define VSUB_OPT_ONLY 1008
+#define VSUB_OPT_ONLY_FROM 1009
 
-static const char *shortopts = "-hdef:s:v:";
+static const char *shortopts = "-hdef:j:s:v:";
 static struct option longopts[] = {
     {"detailed", no_argument, 0, 'd'},
     {"env", no_argument, 0, 'e'},
+    {"engine", required_argument, 0, VSUB_OPT_ENGINE},
     {"format", required_argument, 0, 'f'},
     {"formats", no_argument, 0, VSUB_OPT_FORMATS},
+    {"jobs", required_argument, 0, 'j'},
+    {"list-vars", no_argument, 0, VSUB_OPT_LIST_VARS},
+    {"manifest", required_argument, 0, VSUB_OPT_MANIFEST},
+    {"only", required_argument, 0, VSUB_OPT_ONLY},
+    {"only-from", required_argument, 0, VSUB_OPT_ONLY_FROM},
+    {"output-dir", required_argument, 0, VSUB_OPT_OUTPUT_DIR},
+    {"suffix", required_argument, 0, VSUB_OPT_SUFFIX},
     {"syntax", required_argument, 0, 's'},
     {"syntaxes", no_argument, 0, VSUB_OPT_SYNTAXES},
     {"var", required_argument, 0, 'v'},
     // standard
     {"help", no_argument, 0, 'h'},
     {"version", no_argument, 0, VSUB_OPT_VERSION},
+    {0, 0, 0, 0},
 };
 
+
+// --- error reporting
+
+// path is set when rendering output files
+static void print_run_error(const char *path, const char *outpath, int err, size_t inpc,
+    const char *errvar, const char *errmsg) {
+    const char *pfx = path ? path : "";
+    const char *sep = path ? ": " : "";
+    switch (err) {
+        case VSUB_SUCCESS:
+            break;  // no processing errors
+        case VSUB_ERR_FILE_OPEN:
+            printf_error("%s: %s", vsub_ErrMsg(FILE_OPEN), path);
+            break;
+        case VSUB_ERR_FILE_WRITE:
+            if (outpath) {
+                printf_error("%s: %s", vsub_ErrMsg(FILE_WRITE), outpath);
+            }
+            else {
+                printf_error(vsub_ErrMsg(FILE_WRITE));
+            }
+            break;
+        case VSUB_ERR_MEMORY:
+            printf_error("%s%s%s", pfx, sep, vsub_ErrMsg(MEMORY));
+            break;
+        case VSUB_ERR_SYNTAX:
+            printf_error("%s%s%s: position %zu", pfx, sep, vsub_ErrMsg(SYNTAX), inpc);
+            break;
+        case VSUB_ERR_VARIABLE:
+            if (errvar && errmsg) {
+                // expected
+                printf_error("%s%s%s: %s %s", pfx, sep, vsub_ErrMsg(VARIABLE), errvar, errmsg);
+            }
+            else {
+                // non-reproducible guard
+                printf_error("%s%s%s", pfx, sep, vsub_ErrMsg(VARIABLE));
+            }
+            break;
+        case VSUB_ERR_PARSER:
+            printf_error("%s%s%s: position %zu", pfx, sep, vsub_ErrMsg(PARSER), inpc);
+            break;
+        default:
+            printf_error("%s%s%s: %d", pfx, sep, vsub_ErrMsg(UNKNOWN), err);  // non-reproducible guard
+            break;
+    }
+}
+
+
+// --- var allowlist
+
+// names are separated by commas or whitespace and can be written as $NAME or
+// ${NAME}, so envsubst SHELL-FORMAT strings work too; s is split in place
+static bool add_only_names(PtrArray *names, char *s) {
+    const char *seps = ", \t\r\n";
+    for (char *tok = strtok(s, seps); tok; tok = strtok(NULL, seps)) {
+        char *name = (tok[0] == '$') ? tok + 1 : tok;
+        size_t len = strlen(name);
+        if (name[0] == '{' && len >= 2 && name[len - 1] == '}') {
+            name[--len] = '\0';
+            name++;
+            len--;
+        }
+        bool valid = len > 0 && (name[0] == '_' || (name[0] >= 'a' && name[0] <= 'z') ||
+            (name[0] >= 'A' && name[0] <= 'Z'));
+        for (size_t i = 1; i < len && valid; i++) {
+            char c = name[i];
+            valid = c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+        }
+        if (!valid) {
+            printf_error("invalid var name: %s", tok);
+            return false;
+        }
+        if (!arr_append(names, name)) {
+            printf_error(vsub_ErrMsg(MEMORY));
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool read_only_names(const char *path, PtrArray *names, PtrArray *owned) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        printf_error("%s: %s", vsub_ErrMsg(FILE_OPEN), path);
+        return false;
+    }
+    bool result = true;
+    char *line = NULL;
+    size_t linez = 0;
+    while (result && getline(&line, &linez, fp) != -1) {
+        if (!arr_append(owned, line)) {
+            printf_error(vsub_ErrMsg(MEMORY));
+            result = false;
+            break;
+        }
+        result = add_only_names(names, line);
+        line = NULL;  // owned
+        linez = 0;
+    }
+    free(line);
+    fclose(fp);
+    return result;
+}
+
+
+// --- output files
+
+static const char *path_name(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+// lines are 'input<TAB>output' path pairs, empty lines are skipped
+static bool read_manifest(const char *manifest, PtrArray *inputs, PtrArray *outputs, PtrArray *owned) {
+    FILE *fp = fopen(manifest, "r");
+    if (!fp) {
+        printf_error("%s: %s", vsub_ErrMsg(FILE_OPEN), manifest);
+        return false;
+    }
+    bool result = true;
+    char *line = NULL;
+    size_t linez = 0;
+    ssize_t len;
+    for (size_t lineno = 1; (len = getline(&line, &linez, fp)) != -1; lineno++) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+        if (len == 0) {
+            continue;
+        }
+        char *tab = strchr(line, '\t');
+        if (!tab || tab == line || tab[1] == '\0') {
+            printf_error("invalid manifest line %zu: %s", lineno, manifest);
+            result = false;
+            break;
+        }
+        *tab = '\0';
+        if (!arr_append(owned, line) || !arr_append(inputs, line) || !arr_append(outputs, tab + 1)) {
+            printf_error(vsub_ErrMsg(MEMORY));
+            result = false;
+            break;
+        }
+        line = NULL;  // owned
+        linez = 0;
+    }
+    if (result && ferror(fp)) {
+        printf_error("%s: %s", vsub_ErrMsg(FILE_READ), manifest);
+        result = false;
+    }
+    free(line);
+    fclose(fp);
+    return result;
+}
+
+static bool same_file(const char *path1, const char *path2) {
+    struct stat st1, st2;
+    return stat(path1, &st1) == 0 && stat(path2, &st2) == 0 &&
+        st1.st_dev == st2.st_dev && st1.st_ino == st2.st_ino;
+}
+
+// first output path listed more than once, NULL if none or on memory error
+static const char *dup_output(PtrArray *outputs, bool *memerr) {
+    const char *dup = NULL;
+    StrMap index;
+    map_init(&index, &VSUB_ALLOC_LIBC);
+    *memerr = false;
+    for (size_t i = 0; i < outputs->count && !dup; i++) {
+        const char *path = outputs->items[i];
+        size_t len = strlen(path);
+        bool found;
+        if (!map_insert(&index, path, len, hash_str(path, len), &found)) {
+            *memerr = true;
+            break;
+        }
+        dup = found ? path : NULL;
+    }
+    map_free(&index);
+    return dup;
+}
+
+// render files concurrently, sharing one var table; per-file errors are
+// reported like in single file mode, prefixed with input path
+static bool render_files(Vsub *sub, PtrArray *paths, const char *manifest, const char *outdir,
+    const char *suffix, size_t threads) {
+    bool result = false;
+    PtrArray inputs, outputs, owned;
+    arr_init(&inputs, &VSUB_ALLOC_LIBC);
+    arr_init(&outputs, &VSUB_ALLOC_LIBC);
+    arr_init(&owned, &VSUB_ALLOC_LIBC);
+    VsubVarTable *table = NULL;
+    VsubJob *jobs = NULL;
+    VsubJobResult *results = NULL;
+
+    // output paths
+    suffix = suffix ? suffix : "";
+    for (size_t i = 0; i < paths->count; i++) {
+        const char *path = paths->items[i];
+        char *outpath = outdir ?
+            asprintf("%s/%s%s", outdir, path_name(path), suffix) : asprintf("%s%s", path, suffix);
+        if (!outpath || !arr_append(&owned, outpath) ||
+            !arr_append(&inputs, (void *)path) || !arr_append(&outputs, outpath)) {
+            free(outpath);
+            printf_error(vsub_ErrMsg(MEMORY));
+            goto done;
+        }
+    }
+    if (manifest && !read_manifest(manifest, &inputs, &outputs, &owned)) {
+        goto done;
+    }
+    for (size_t i = 0; i < inputs.count; i++) {
+        if (same_file(inputs.items[i], outputs.items[i])) {
+            printf_error("output file is input file: %s", (char *)outputs.items[i]);
+            goto done;
+        }
+    }
+    bool memerr;
+    const char *dup = dup_output(&outputs, &memerr);
+    if (memerr) {
+        printf_error(vsub_ErrMsg(MEMORY));
+        goto done;
+    }
+    if (dup) {
+        printf_error("output file is listed more than once: %s", dup);
+        goto done;
+    }
+
+    // render
+    if (!(table = vsub_ShareVars(sub)) ||
+        !(jobs = calloc(inputs.count, sizeof(VsubJob))) ||
+        !(results = calloc(inputs.count, sizeof(VsubJobResult)))) {
+        printf_error(vsub_ErrMsg(MEMORY));
+        goto done;
+    }
+    for (size_t i = 0; i < inputs.count; i++) {
+        jobs[i].path = inputs.items[i];
+        jobs[i].vars = table;
+        jobs[i].outpath = outputs.items[i];
+    }
+    vsub_run_batch(sub, jobs, results, inputs.count, threads);
+
+    // report
+    size_t failed = 0;
+    for (size_t i = 0; i < inputs.count; i++) {
+        const VsubJobResult *res = &results[i];
+        if (res->err != VSUB_SUCCESS) {
+            print_run_error(inputs.items[i], outputs.items[i], res->err, res->inpc, res->errvar, res->errmsg);
+            failed++;
+        }
+    }
+    if (failed) {
+        printf_error("%zu of %zu files failed", failed, inputs.count);
+    }
+    result = (failed == 0);
+
+done:
+    if (results) {
+        vsub_free_batch(results, inputs.count);
+    }
+    free(results);
+    free(jobs);
+    vsub_FreeVarTable(table);
+    for (size_t i = 0; i < owned.count; i++) {
+        free(owned.items[i]);
+    }
+    arr_free(&owned);
+    arr_free(&outputs);
+    arr_free(&inputs);
+    return result;
+}
+
+
+// --- main
+
 int main(int argc, char *argv[]) {
     // control flow
     bool result = true;
     // options
     bool use_detailed = false;
     bool use_env = false;
+    bool use_list_vars = false;
     char *use_format = NULL;
     char *use_syntax = "envsubst";
+    char *use_engine = "scan";
     PtrArray vars;
-    arr_init(&vars);
+    arr_init(&vars, &VSUB_ALLOC_LIBC);
+    PtrArray paths;
+    arr_init(&paths, &VSUB_ALLOC_LIBC);
+    // var allowlist
+    bool use_only = false;
+    PtrArray only, only_owned;
+    arr_init(&only, &VSUB_ALLOC_LIBC);
+    arr_init(&only_owned, &VSUB_ALLOC_LIBC);
+    VsubAllowlist *allowlist = NULL;
     char *path = NULL;
-    int pathind = 0;
+    // output files
+    size_t use_jobs = 1;
+    char *use_outdir = NULL;
+    char *use_suffix = NULL;
+    char *use_manifest = NULL;
     // parser
-    Vsub sub;
+    Vsub sub = {0};  // safe to free before init
     FILE *fp = stdin;
 
     // --- parse options
@@ -108,9 +422,48 @@ int main(int argc, char *argv[]) {
             case 'f':
                 use_format = optarg;
                 break;
+            case 'j': {
+                char *end;
+                use_jobs = strtoul(optarg, &end, 10);
+                if (*optarg < '0' || *optarg > '9' || *end != '\0') {
+                    printf_error("invalid jobs count: %s", optarg);
+                    result = false;
+                    goto done;
+                }
+                break;
+            }
+            case VSUB_OPT_OUTPUT_DIR:
+                use_outdir = optarg;
+                break;
+            case VSUB_OPT_SUFFIX:
+                use_suffix = optarg;
+                break;
+            case VSUB_OPT_MANIFEST:
+                use_manifest = optarg;
+                break;
+            case VSUB_OPT_LIST_VARS:
+                use_list_vars = true;
+                break;
+            case VSUB_OPT_ONLY:
+                use_only = true;
+                if (!add_only_names(&only, optarg)) {
+                    result = false;
+                    goto done;
+                }
+                break;
+            case VSUB_OPT_ONLY_FROM:
+                use_only = true;
+                if (!read_only_names(optarg, &only, &only_owned)) {
+                    result = false;
+                    goto done;
+                }
+                break;
             case 's':
                 use_syntax = optarg;
                 break;
+            case VSUB_OPT_ENGINE:
+                use_engine = optarg;
+                break;
             case 'v':
                 if (!arr_append(&vars, optarg)) {
                     printf_error(vsub_ErrMsg(MEMORY));
@@ -126,13 +479,11 @@ int main(int argc, char *argv[]) {
                 goto done;
             // positional
             case 1:
-                if (pathind > 0) {
-                    printf_error("multiple paths not allowed");
+                if (!arr_append(&paths, argv[optind - 1])) {
+                    printf_error(vsub_ErrMsg(MEMORY));
                     result = false;
                     goto done;
                 }
-                pathind = optind - 1;
-                path = argv[pathind];
                 break;
             // errors
             case '?':
@@ -146,6 +497,22 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    // output files are written for multiple paths, stdout is used otherwise
+    bool use_files = use_outdir || use_suffix || use_manifest;
+    if (paths.count > 1 && !use_files) {
+        printf_error("multiple paths require --output-dir, --suffix or --manifest");
+        result = false;
+        goto done;
+    }
+    if (use_files && !paths.count && !use_manifest) {
+        printf_error("output files require input paths or --manifest");
+        result = false;
+        goto done;
+    }
+    if (paths.count == 1) {
+        path = paths.items[0];
+    }
+
     // --- initialize context
 
     if (!vsub_init(&sub)) {
@@ -163,15 +530,26 @@ int main(int argc, char *argv[]) {
         goto done;
     }
 
+    // engine
+    if ((sub.engine = vsub_FindEngine(use_engine)) == NULL) {
+        printf_error("unsupported engine: %s", use_engine);
+        result = false;
+        goto done;
+    }
+
     // input
-    if (path) {
+    if (use_files) {
+        // files are opened by rendering threads
+    }
+    else if (path) {
         if (!(fp = fopen(path, "r"))) {
             printf_error("%s: %s", vsub_ErrMsg(FILE_OPEN), path);
             result = false;
             goto done;
         }
     }
-    if (!vsub_UseTextFromFile(&sub, fp)) {
+    // regular files are mapped, other inputs are streamed
+    if (!use_files && !(path && vsub_UseTextFromMmap(&sub, fileno(fp))) && !vsub_UseTextFromFile(&sub, fp)) {
         printf_error(vsub_ErrMsg(MEMORY));
         result = false;
         goto done;
@@ -179,7 +557,7 @@ int main(int argc, char *argv[]) {
 
     // vars
     if (use_env) {
-        if (!vsub_UseVarsFromEnv(&sub)) {
+        if (!vsub_UseVarsFromEnvSnapshot(&sub, NULL)) {
             printf_error(vsub_ErrMsg(MEMORY));
             result = false;
             goto done;
@@ -192,6 +570,22 @@ int main(int argc, char *argv[]) {
             goto done;
         }
     }
+    if (!vsub_FreezeVars(&sub)) {
+        printf_error(vsub_ErrMsg(MEMORY));
+        result = false;
+        goto done;
+    }
+    if (use_only) {
+        if (!(allowlist = vsub_CompileAllowlist(only.count, (const char **)only.items))) {
+            printf_error(vsub_ErrMsg(MEMORY));
+            result = false;
+            goto done;
+        }
+        sub.only = allowlist;
+    }
+
+    // threads split single mapped input into chunks
+    sub.threads = use_jobs;
 
     // format
     int outfmt;
@@ -206,6 +600,56 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    // --- list referenced vars
+
+    if (use_list_vars) {
+        if (use_files) {
+            printf_error("--list-vars doesn't write output files");
+            result = false;
+            goto done;
+        }
+        if (outfmt == VSUB_FMT_PRETTY) {
+            printf_error("--list-vars supports plain and json formats only");
+            result = false;
+            goto done;
+        }
+        const VsubVarRef *refs;
+        size_t count;
+        if (!vsub_scan_vars(&sub, &refs, &count)) {
+            print_run_error(NULL, NULL, sub.err, sub.inpc, sub.errvar, sub.errmsg);
+            result = false;
+            goto done;
+        }
+        int outres = (outfmt == VSUB_FMT_JSON) ?
+            vsub_OutputVarsJson(refs, count, stdout) : vsub_OutputVarsPlain(refs, count, stdout);
+        if (outres != VSUB_SUCCESS) {
+            printf_error(vsub_ErrMsg(OUTPUT));
+            result = false;
+        }
+        goto done;
+    }
+
+    // --- process output files
+
+    if (use_files) {
+        if (outfmt != VSUB_FMT_PLAIN) {
+            printf_error("output files support plain format only");
+            result = false;
+            goto done;
+        }
+        result = render_files(&sub, &paths, use_manifest, use_outdir, use_suffix, use_jobs);
+        goto done;
+    }
+
+    // plain result is written to stdout while parsing
+    if (outfmt == VSUB_FMT_PLAIN) {
+        if (!vsub_UseSinkFd(&sub, STDOUT_FILENO)) {
+            printf_error(vsub_ErrMsg(MEMORY));
+            result = false;
+            goto done;
+        }
+    }
+
     // --- process
 
     if (!vsub_alloc(&sub)) {
@@ -256,39 +700,21 @@ processing_failed:
 
     // --- report processing error
 
-    switch (sub.err) {
-        case VSUB_SUCCESS:
-            break;  // no processing errors
-        case VSUB_ERR_MEMORY:
-            printf_error(vsub_ErrMsg(MEMORY));
-            break;
-        case VSUB_ERR_SYNTAX:
-            printf_error("%s: position %ld", vsub_ErrMsg(MEMORY), sub.inpc);
-            break;
-        case VSUB_ERR_VARIABLE:
-            if (sub.errvar && sub.errmsg) {
-                // expected
-                printf_error("%s: %s %s", vsub_ErrMsg(VARIABLE), sub.errvar, sub.errmsg);
-            }
-            else {
-                // non-reproducible guard
-                printf_error(vsub_ErrMsg(VARIABLE));
-            }
-            break;
-        case VSUB_ERR_PARSER:
-            printf_error("%s: position %ld", vsub_ErrMsg(PARSER), sub.inpc);
-            break;
-        default:
-            printf_error("%s: %d", vsub_ErrMsg(UNKNOWN), sub.err);  // non-reproducible guard
-            break;
-    }
+    print_run_error(NULL, NULL, sub.err, sub.inpc, sub.errvar, sub.errmsg);
 
 done:
 
     // --- finalize
 
     arr_free(&vars);
+    arr_free(&paths);
     vsub_free(&sub);
+    vsub_FreeAllowlist(allowlist);  // after context, which borrows it
+    for (size_t i = 0; i < only_owned.count; i++) {
+        free(only_owned.items[i]);
+    }
+    arr_free(&only_owned);
+    arr_free(&only);
     if (fp != stdin && fp != NULL) {
         fclose(fp);
     }
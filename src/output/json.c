@@ -26,3 +26,40 @@ done:
     }
     return ret;
 }
+
+int vsub_OutputVarsJson(const VsubVarRef *refs, size_t count, FILE *fp) {
+    int ret = 0;
+    char *text = NULL;
+    cJSON *data = cJSON_CreateObject();
+    cJSON *vars = data ? cJSON_AddArrayToObject(data, "vars") : NULL;
+    if (!vars) {
+        ret = EOF;
+        goto done;
+    }
+    for (size_t i = 0; i < count; i++) {
+        cJSON *ref = cJSON_CreateObject();
+        if (!ref || !cJSON_AddItemToArray(vars, ref)) {
+            cJSON_Delete(ref);
+            ret = EOF;
+            goto done;
+        }
+        if (!cJSON_AddStringToObject(ref, "name", refs[i].name) ||
+            !cJSON_AddNumberToObject(ref, "count", refs[i].count) ||
+            !cJSON_AddNumberToObject(ref, "first", refs[i].first)) {
+            ret = EOF;
+            goto done;
+        }
+    }
+    if (!(text = cJSON_PrintUnformatted(data))) {
+        ret = EOF;
+        goto done;
+    }
+    fprintf(fp, "%s\n", text);
+
+done:
+    cJSON_Delete(data);
+    if (text) {
+        free(text);
+    }
+    return ret;
+}
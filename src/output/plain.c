@@ -4,7 +4,16 @@
 
 int vsub_OutputPlain(Vsub *sub, FILE *fp) {
     if (sub->res) {
-        if (fprintf(fp, "%s", sub->res) < 0) {
+        if (fwrite(sub->res, 1, sub->resc, fp) < sub->resc) {
+            return VSUB_ERR_FILE_WRITE;
+        }
+    }
+    return VSUB_SUCCESS;
+}
+
+int vsub_OutputVarsPlain(const VsubVarRef *refs, size_t count, FILE *fp) {
+    for (size_t i = 0; i < count; i++) {
+        if (fprintf(fp, "%s\t%zu\t%zu\n", refs[i].name, refs[i].count, refs[i].first) < 0) {
             return VSUB_ERR_FILE_WRITE;
         }
     }
@@ -0,0 +1,151 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aux.h"
+
+
+// parsers allocate and free many small blocks on every run; freed blocks are
+// kept in free lists by size class, so that warm context parses without heap
+// allocations; blocks up to 4K are carved from slabs, larger ones have their
+// own allocation; slabs and large blocks are aligned to slab size and start
+// with a header, so that block header is found by masking block address
+
+#define POOL_SLAB 65536  // slab size and alignment
+#define POOL_SLABS 16    // slabs allocated at once
+#define POOL_SMALL_CLASSES (VSUB_POOL_SMALL / VSUB_POOL_STEP)
+#define POOL_SLAB_CLASSES (POOL_SMALL_CLASSES + 3)
+#define POOL_SIZE(cls) ((cls) < POOL_SMALL_CLASSES ? ((cls) + 1) * VSUB_POOL_STEP : \
+    (size_t)VSUB_POOL_SMALL << ((cls) - POOL_SMALL_CLASSES + 1))
+
+typedef struct PoolHead {
+    size_t cls;   // size class, or VSUB_POOL_CLASSES if not pooled
+    size_t size;  // block size if not pooled
+    void *mem;    // allocation starting with this head, or NULL
+    struct PoolHead *next;  // next pooled head
+} PoolHead;
+
+#define POOL_HEAD ((sizeof(PoolHead) + 15) & ~(size_t)15)  // keeps blocks aligned
+
+static size_t pool_class(size_t size) {
+    if (size <= VSUB_POOL_SMALL) {
+        return (size > 0) ? (size - 1) / VSUB_POOL_STEP : 0;
+    }
+    size_t cls = POOL_SMALL_CLASSES;
+    while (cls < VSUB_POOL_CLASSES && POOL_SIZE(cls) < size) {
+        cls++;
+    }
+    return cls;
+}
+
+static PoolHead *pool_head(void *ptr) {
+    return (PoolHead *)((uintptr_t)ptr & ~(uintptr_t)(POOL_SLAB - 1));
+}
+
+// allocate size bytes aligned to slab; unused alignment space is not touched
+static PoolHead *pool_alloc(Auxil *aux, size_t size) {
+    void *mem = MEM_ALLOC(aux->sub->alloc, size + POOL_SLAB - 1);
+    if (!mem) {
+        longjmp(aux->oom, 1);
+    }
+    PoolHead *head = pool_head((char *)mem + POOL_SLAB - 1);
+    head->mem = mem;
+    return head;
+}
+
+static PoolHead *pool_slab(Auxil *aux) {
+    VsubPool *pool = &aux->pool;
+    PoolHead *head;
+    if (pool->next == pool->end) {
+        head = pool_alloc(aux, POOL_SLABS * POOL_SLAB);
+        pool->next = (char *)head;
+        pool->end = pool->next + POOL_SLABS * POOL_SLAB;
+    }
+    else {
+        head = (PoolHead *)pool->next;
+        head->mem = NULL;
+    }
+    pool->next += POOL_SLAB;
+    return head;
+}
+
+// add slab, or large block, to free list of size class
+static void pool_refill(Auxil *aux, size_t cls) {
+    VsubPool *pool = &aux->pool;
+    size_t bsize = POOL_SIZE(cls);
+    size_t size = (cls < POOL_SLAB_CLASSES) ? POOL_SLAB : POOL_HEAD + bsize;
+    PoolHead *head = (cls < POOL_SLAB_CLASSES) ? pool_slab(aux) : pool_alloc(aux, size);
+    head->cls = cls;
+    head->next = pool->heads;
+    pool->heads = head;
+    for (char *b = (char *)head + POOL_HEAD; b + bsize <= (char *)head + size; b += bsize) {
+        *(void **)b = pool->free[cls];
+        pool->free[cls] = b;
+    }
+}
+
+void vsub_pool_init(Auxil *aux) {
+    for (size_t cls = 0; cls < VSUB_POOL_CLASSES; cls++) {
+        aux->pool.free[cls] = NULL;
+    }
+    aux->pool.heads = NULL;
+    aux->pool.next = aux->pool.end = NULL;
+}
+
+void *vsub_pool_malloc(Auxil *aux, size_t size) {
+    VsubPool *pool = &aux->pool;
+    size_t cls = pool_class(size);
+    if (cls == VSUB_POOL_CLASSES) {
+        PoolHead *head = pool_alloc(aux, POOL_HEAD + size);
+        head->cls = cls;
+        head->size = size;
+        return (char *)head + POOL_HEAD;
+    }
+    if (!pool->free[cls]) {
+        pool_refill(aux, cls);
+    }
+    void **block = pool->free[cls];
+    pool->free[cls] = *block;
+    return block;
+}
+
+void *vsub_pool_realloc(Auxil *aux, void *ptr, size_t size) {
+    if (!ptr) {
+        return vsub_pool_malloc(aux, size);
+    }
+    PoolHead *head = pool_head(ptr);
+    size_t cur = (head->cls < VSUB_POOL_CLASSES) ? POOL_SIZE(head->cls) : head->size;
+    if (size <= cur) {
+        return ptr;
+    }
+    void *newptr = vsub_pool_malloc(aux, size);
+    memcpy(newptr, ptr, cur);
+    vsub_pool_free(aux, ptr);
+    return newptr;
+}
+
+void vsub_pool_free(Auxil *aux, void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    PoolHead *head = pool_head(ptr);
+    if (head->cls == VSUB_POOL_CLASSES) {
+        MEM_FREE(aux->sub->alloc, head->mem);
+        return;
+    }
+    *(void **)ptr = aux->pool.free[head->cls];
+    aux->pool.free[head->cls] = ptr;
+}
+
+// slabs are listed after slabs carved later from the same allocation, so
+// the allocation is freed after all its heads are visited
+void vsub_pool_release(Auxil *aux) {
+    PoolHead *head = aux->pool.heads;
+    while (head) {
+        PoolHead *next = head->next;
+        if (head->mem) {
+            MEM_FREE(aux->sub->alloc, head->mem);
+        }
+        head = next;
+    }
+    vsub_pool_init(aux);
+}
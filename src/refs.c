@@ -0,0 +1,106 @@
+#include <string.h>
+#include "aux.h"
+#include "engine/scan.h"
+
+
+// var references found by the last scan, owned by context
+typedef struct VsubRefs {
+    VsubVarRef *items;  // in order of first reference
+    size_t count;
+    size_t avail;
+    StrMap index;       // name to item index
+} VsubRefs;
+
+static void refs_clear(Vsub *sub, VsubRefs *refs) {
+    for (size_t i = 0; i < refs->count; i++) {
+        MEM_FREE(sub->alloc, (char *)refs->items[i].name);
+    }
+    refs->count = 0;
+    map_free(&refs->index);
+}
+
+static bool refs_add(Vsub *sub, const char *name, size_t len, size_t pos) {
+    VsubRefs *refs = ((Auxil *)sub->aux)->refs;
+    uint64_t hash = hash_str(name, len);
+    StrMapItem *item = map_find(&refs->index, name, len, hash);
+    if (item) {
+        refs->items[item->vlen].count++;
+        return true;
+    }
+    if (refs->count == refs->avail) {
+        size_t avail = MAX(16, refs->avail * 2);
+        VsubVarRef *items = MEM_REALLOC(sub->alloc, refs->items, avail * sizeof(VsubVarRef));
+        if (!items) {
+            sub->err = VSUB_ERR_MEMORY;
+            return false;
+        }
+        refs->items = items;
+        refs->avail = avail;
+    }
+    char *copy = MEM_ALLOC(sub->alloc, len + 1);
+    if (!copy) {
+        sub->err = VSUB_ERR_MEMORY;
+        return false;
+    }
+    memcpy(copy, name, len);
+    copy[len] = '\0';
+    bool found;
+    if (!(item = map_insert(&refs->index, copy, len, hash, &found))) {
+        MEM_FREE(sub->alloc, copy);
+        sub->err = VSUB_ERR_MEMORY;
+        return false;
+    }
+    item->vlen = refs->count;
+    refs->items[refs->count++] = (VsubVarRef){.name = copy, .count = 1, .first = pos};
+    return true;
+}
+
+
+// --- internal api
+
+void vsub_free_refs(Vsub *sub) {
+    Auxil *aux = sub->aux;
+    VsubRefs *refs = aux->refs;
+    if (refs) {
+        refs_clear(sub, refs);
+        MEM_FREE(sub->alloc, refs->items);
+        MEM_FREE(sub->alloc, refs);
+        aux->refs = NULL;
+    }
+}
+
+
+// --- vsub user api
+
+bool vsub_scan_vars(Vsub *sub, const VsubVarRef **refs, size_t *count) {
+    Auxil *aux = sub->aux;
+    *refs = NULL;
+    *count = 0;
+    vsub_clear_results(sub);
+    if (!aux->refs) {
+        VsubRefs *r = MEM_ALLOC(sub->alloc, sizeof(VsubRefs));
+        if (!r) {
+            sub->err = VSUB_ERR_MEMORY;
+            return false;
+        }
+        r->items = NULL;
+        r->count = r->avail = 0;
+        map_init(&r->index, sub->alloc);
+        aux->refs = r;
+    }
+    refs_clear(sub, aux->refs);
+    // scanner context is cheap, parser context of sub is left alone
+    vsub_en_scan_context_t *ctx = vsub_en_scan_create(aux);
+    if (!ctx) {
+        sub->err = VSUB_ERR_MEMORY;
+        return false;
+    }
+    bool ok = vsub_en_scan_refs(ctx, (VsubRefFn)refs_add, sub);
+    vsub_en_scan_destroy(ctx);
+    if (!ok) {
+        return false;
+    }
+    *refs = ((VsubRefs *)aux->refs)->items;
+    *count = ((VsubRefs *)aux->refs)->count;
+    return true;
+}
@@ -0,0 +1,41 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "../util.h"
+#include "../vsubio.h"
+
+
+static const char *NAME = "fd";
+
+typedef struct VsubSinkFd {
+    struct VsubSink super;
+    int fd;
+} VsubSinkFd;
+
+static bool _write(VsubSinkFd *snk, const char *buf, size_t n) {
+    while (n > 0) {
+        ssize_t done = write(snk->fd, buf, n);
+        if (done < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        buf += done;
+        n -= done;
+    }
+    return true;
+}
+
+bool vsub_UseSinkFd(Vsub *sub, int fd) {
+    VsubSinkFd *snk = MEM_ALLOC(sub->alloc, sizeof(VsubSinkFd));
+    if (!snk) {
+        return false;
+    }
+    ((VsubSink *)snk)->name = NAME;
+    ((VsubSink *)snk)->write = (bool (*)(void *, const char *, size_t))_write;
+    ((VsubSink *)snk)->close = NULL;
+    snk->fd = fd;
+    vsub_SetSink(sub, (VsubSink *)snk);
+    return true;
+}
@@ -0,0 +1,29 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "../util.h"
+#include "../vsubio.h"
+
+
+static const char *NAME = "file";
+
+typedef struct VsubSinkFile {
+    struct VsubSink super;
+    FILE *fp;
+} VsubSinkFile;
+
+static bool _write(VsubSinkFile *snk, const char *buf, size_t n) {
+    return fwrite(buf, 1, n, snk->fp) == n;
+}
+
+bool vsub_UseSinkFile(Vsub *sub, FILE *fp) {
+    VsubSinkFile *snk = MEM_ALLOC(sub->alloc, sizeof(VsubSinkFile));
+    if (!snk) {
+        return false;
+    }
+    ((VsubSink *)snk)->name = NAME;
+    ((VsubSink *)snk)->write = (bool (*)(void *, const char *, size_t))_write;
+    ((VsubSink *)snk)->close = NULL;
+    snk->fp = fp;
+    vsub_SetSink(sub, (VsubSink *)snk);
+    return true;
+}
@@ -0,0 +1,30 @@
+#include <stdlib.h>
+#include "../util.h"
+#include "../vsubio.h"
+
+
+static const char *NAME = "func";
+
+typedef struct VsubSinkFunc {
+    struct VsubSink super;
+    bool (*write)(void *data, const char *buf, size_t n);
+    void *data;
+} VsubSinkFunc;
+
+static bool _write(VsubSinkFunc *snk, const char *buf, size_t n) {
+    return snk->write(snk->data, buf, n);
+}
+
+bool vsub_UseSink(Vsub *sub, bool (*write)(void *data, const char *buf, size_t n), void *data) {
+    VsubSinkFunc *snk = MEM_ALLOC(sub->alloc, sizeof(VsubSinkFunc));
+    if (!snk) {
+        return false;
+    }
+    ((VsubSink *)snk)->name = NAME;
+    ((VsubSink *)snk)->write = (bool (*)(void *, const char *, size_t))_write;
+    ((VsubSink *)snk)->close = NULL;
+    snk->write = write;
+    snk->data = data;
+    vsub_SetSink(sub, (VsubSink *)snk);
+    return true;
+}
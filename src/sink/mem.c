@@ -0,0 +1,52 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../util.h"
+#include "../vsubio.h"
+
+
+static const char *NAME = "mem";
+
+#define VSUB_SINK_MEM_MIN 256  // initial buffer size
+
+typedef struct VsubSinkMem {
+    struct VsubSink super;
+    char **buf;   // zero terminated, owned by caller
+    size_t *len;
+    size_t size;
+} VsubSinkMem;
+
+static bool _write(VsubSinkMem *snk, const char *buf, size_t n) {
+    if (*snk->len + n + 1 > snk->size) {
+        size_t sz = snk->size ? snk->size : VSUB_SINK_MEM_MIN;
+        while (sz < *snk->len + n + 1) {
+            sz *= 2;
+        }
+        char *newbuf = realloc(*snk->buf, sz);
+        if (!newbuf) {
+            return false;
+        }
+        *snk->buf = newbuf;
+        snk->size = sz;
+    }
+    memcpy(*snk->buf + *snk->len, buf, n);
+    *snk->len += n;
+    (*snk->buf)[*snk->len] = '\0';
+    return true;
+}
+
+bool vsub_UseSinkMem(Vsub *sub, char **buf, size_t *len) {
+    VsubSinkMem *snk = MEM_ALLOC(sub->alloc, sizeof(VsubSinkMem));
+    if (!snk) {
+        return false;
+    }
+    ((VsubSink *)snk)->name = NAME;
+    ((VsubSink *)snk)->write = (bool (*)(void *, const char *, size_t))_write;
+    ((VsubSink *)snk)->close = NULL;
+    snk->buf = buf;
+    snk->len = len;
+    snk->size = 0;
+    *buf = NULL;
+    *len = 0;
+    vsub_SetSink(sub, (VsubSink *)snk);
+    return true;
+}
@@ -1,4 +1,5 @@
 /* A packrat parser generated by PackCC 2.0.2 */
+/* Edited by hand as packcc -a would emit it from the .peg file; see Taskfile.yaml */
 
 #ifndef PCC_INCLUDED_COMPOSE243_H
 #define PCC_INCLUDED_COMPOSE243_H
@@ -12,7 +13,7 @@ extern "C" {
 typedef struct vsub_sx_compose243_context_tag vsub_sx_compose243_context_t;
 
 vsub_sx_compose243_context_t *vsub_sx_compose243_create(Auxil *auxil);
-int vsub_sx_compose243_parse(vsub_sx_compose243_context_t *ctx, const char **ret);
+int vsub_sx_compose243_parse(vsub_sx_compose243_context_t *ctx, VsubSpan *ret);
 void vsub_sx_compose243_destroy(vsub_sx_compose243_context_t *ctx);
 
 #ifdef __cplusplus
@@ -1,4 +1,5 @@
 /* A packrat parser generated by PackCC 2.0.2 */
+/* Edited by hand as packcc -a would emit it from the .peg file; see Taskfile.yaml */
 
 #ifdef _MSC_VER
 #undef _CRT_SECURE_NO_WARNINGS
@@ -75,7 +76,7 @@ typedef struct pcc_range_tag {
     size_t end;
 } pcc_range_t;
 
-typedef const char *pcc_value_t;
+typedef VsubSpan pcc_value_t;
 
 typedef Auxil *pcc_auxil_t;
 
@@ -956,58 +957,6 @@ static const char *pcc_get_capture_string(pcc_context_t *ctx, const pcc_capture_
     return capt->string;
 }
 
-static size_t pcc_get_char_as_utf32(pcc_context_t *ctx, int *out) { /* with checking UTF-8 validity */
-    int c, u;
-    size_t n;
-    if (pcc_refill_buffer(ctx, 1) < 1) return 0;
-    c = (int)(unsigned char)ctx->buffer.buf[ctx->cur];
-    n = (c < 0x80) ? 1 :
-        ((c & 0xe0) == 0xc0) ? 2 :
-        ((c & 0xf0) == 0xe0) ? 3 :
-        ((c & 0xf8) == 0xf0) ? 4 : 0;
-    if (n < 1) return 0;
-    if (pcc_refill_buffer(ctx, n) < n) return 0;
-    switch (n) {
-    case 1:
-        u = c;
-        break;
-    case 2:
-        u = c & 0x1f;
-        c = (int)(unsigned char)ctx->buffer.buf[ctx->cur + 1];
-        if ((c & 0xc0) != 0x80) return 0;
-        u <<= 6; u |= c & 0x3f;
-        if (u < 0x80) return 0;
-        break;
-    case 3:
-        u = c & 0x0f;
-        c = (int)(unsigned char)ctx->buffer.buf[ctx->cur + 1];
-        if ((c & 0xc0) != 0x80) return 0;
-        u <<= 6; u |= c & 0x3f;
-        c = (int)(unsigned char)ctx->buffer.buf[ctx->cur + 2];
-        if ((c & 0xc0) != 0x80) return 0;
-        u <<= 6; u |= c & 0x3f;
-        if (u < 0x800) return 0;
-        break;
-    case 4:
-        u = c & 0x07;
-        c = (int)(unsigned char)ctx->buffer.buf[ctx->cur + 1];
-        if ((c & 0xc0) != 0x80) return 0;
-        u <<= 6; u |= c & 0x3f;
-        c = (int)(unsigned char)ctx->buffer.buf[ctx->cur + 2];
-        if ((c & 0xc0) != 0x80) return 0;
-        u <<= 6; u |= c & 0x3f;
-        c = (int)(unsigned char)ctx->buffer.buf[ctx->cur + 3];
-        if ((c & 0xc0) != 0x80) return 0;
-        u <<= 6; u |= c & 0x3f;
-        if (u < 0x10000 || u > 0x10ffff) return 0;
-        break;
-    default:
-        return 0;
-    }
-    if (out) *out = u;
-    return n;
-}
-
 MARK_FUNC_AS_USED
 static pcc_bool_t pcc_apply_rule(pcc_context_t *ctx, pcc_rule_t rule, pcc_thunk_array_t *thunks, pcc_value_t *value) {
     static pcc_value_t null;
@@ -1195,7 +1144,7 @@ static void pcc_action_var_0(vsub_sx_envsubst_context_t *__pcc_ctx, pcc_thunk_t
 #define _1 pcc_get_capture_string(__pcc_ctx, __pcc_in->data.leaf.capts.buf[0])
 #define _1s ((const size_t)(__pcc_ctx->pos + __pcc_in->data.leaf.capts.buf[0]->range.start))
 #define _1e ((const size_t)(__pcc_ctx->pos + __pcc_in->data.leaf.capts.buf[0]->range.end))
-    __ = _1;
+    __ = SPAN(1);
 #undef _1e
 #undef _1s
 #undef _1
@@ -1215,32 +1164,7 @@ static pcc_thunk_chunk_t *pcc_evaluate_rule_input(pcc_context_t *ctx) {
     chunk->pos = ctx->cur;
     PCC_DEBUG(ctx->auxil, PCC_DBG_EVALUATE, "input", ctx->level, chunk->pos, (ctx->buffer.buf + chunk->pos), (ctx->buffer.len - chunk->pos));
     ctx->level++;
-    {
-        for (;;) {
-            const size_t p = ctx->cur;
-            const size_t n = chunk->thunks.len;
-            if (!pcc_apply_rule(ctx, pcc_evaluate_rule_atom, &chunk->thunks, NULL)) goto L0001;
-            if (ctx->cur == p) break;
-            continue;
-        L0001:;
-            ctx->cur = p;
-            pcc_thunk_array__revert(ctx->auxil, &chunk->thunks, n);
-            break;
-        }
-    }
-    {
-        const size_t p = ctx->cur;
-        {
-            int u;
-            const size_t n = pcc_get_char_as_utf32(ctx, &u);
-            if (n == 0) goto L0002;
-            ctx->cur += n;
-        }
-        ctx->cur = p;
-        goto L0000;
-    L0002:;
-        ctx->cur = p;
-    }
+    if (!pcc_apply_rule(ctx, pcc_evaluate_rule_atom, &chunk->thunks, NULL)) goto L0000;
     ctx->level--;
     PCC_DEBUG(ctx->auxil, PCC_DBG_MATCH, "input", ctx->level, chunk->pos, (ctx->buffer.buf + chunk->pos), (ctx->cur - chunk->pos));
     return chunk;
@@ -1317,12 +1241,10 @@ static pcc_thunk_chunk_t *pcc_evaluate_rule_atom(pcc_context_t *ctx) {
     L0004:;
         ctx->cur = p;
         pcc_thunk_array__revert(ctx->auxil, &chunk->thunks, n);
-        {
-            int u;
-            const size_t n = pcc_get_char_as_utf32(ctx, &u);
-            if (n == 0) goto L0005;
-            ctx->cur += n;
-        }
+        if (
+            pcc_refill_buffer(ctx, 1) < 1
+        ) goto L0005;
+        ctx->cur++;
         {
             pcc_thunk_t *const thunk = pcc_thunk__create_leaf(ctx->auxil, pcc_action_atom_3, 1, 0);
             thunk->data.leaf.capt0.range.start = chunk->pos;
@@ -1356,31 +1278,31 @@ static pcc_thunk_chunk_t *pcc_evaluate_rule_var(pcc_context_t *ctx) {
         const size_t p = ctx->cur;
         size_t q;
         {
-            int u;
-            const size_t n = pcc_get_char_as_utf32(ctx, &u);
-            if (n == 0) goto L0000;
+            char c;
+            if (pcc_refill_buffer(ctx, 1) < 1) goto L0000;
+            c = ctx->buffer.buf[ctx->cur];
             if (!(
-                u == 0x00005f ||
-                (u >= 0x000061 && u <= 0x00007a) ||
-                (u >= 0x000041 && u <= 0x00005a)
+                c == '_' ||
+                (c >= 'a' && c <= 'z') ||
+                (c >= 'A' && c <= 'Z')
             )) goto L0000;
-            ctx->cur += n;
+            ctx->cur++;
         }
         {
             for (;;) {
                 const size_t p = ctx->cur;
                 const size_t n = chunk->thunks.len;
                 {
-                    int u;
-                    const size_t n = pcc_get_char_as_utf32(ctx, &u);
-                    if (n == 0) goto L0001;
+                    char c;
+                    if (pcc_refill_buffer(ctx, 1) < 1) goto L0001;
+                    c = ctx->buffer.buf[ctx->cur];
                     if (!(
-                        u == 0x00005f ||
-                        (u >= 0x000061 && u <= 0x00007a) ||
-                        (u >= 0x000041 && u <= 0x00005a) ||
-                        (u >= 0x000030 && u <= 0x000039)
+                        c == '_' ||
+                        (c >= 'a' && c <= 'z') ||
+                        (c >= 'A' && c <= 'Z') ||
+                        (c >= '0' && c <= '9')
                     )) goto L0001;
-                    ctx->cur += n;
+                    ctx->cur++;
                 }
                 if (ctx->cur == p) break;
                 continue;
@@ -1415,7 +1337,7 @@ vsub_sx_envsubst_context_t *vsub_sx_envsubst_create(Auxil *auxil) {
     return pcc_context__create(auxil);
 }
 
-int vsub_sx_envsubst_parse(vsub_sx_envsubst_context_t *ctx, const char **ret) {
+int vsub_sx_envsubst_parse(vsub_sx_envsubst_context_t *ctx, VsubSpan *ret) {
     if (pcc_refill_buffer(ctx, 1) < 1) return 0;
     if (pcc_apply_rule(ctx, pcc_evaluate_rule_input, &ctx->thunks, ret))
         pcc_do_action(ctx, &ctx->thunks, ret);
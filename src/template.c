@@ -0,0 +1,227 @@
+#include <stdlib.h>
+#include <string.h>
+#include "aux.h"
+#include "util.h"
+#include "vsub.h"
+
+
+// template is a flat list of literal texts and var references; unique var names
+// are indexed by hash, so every name is resolved once per render
+
+typedef struct VsubTplItem {
+    size_t text;  // literal text, or unset var fallback, offset
+    size_t len;   // literal text, or unset var fallback, length
+    size_t var;   // var name index + 1, or 0 for literal text
+    size_t epos;  // input position after the item
+    bool braced;  // var reference is ${NAME}, not $NAME
+} VsubTplItem;
+
+struct VsubTemplate {
+    char *text;          // all literal texts and fallbacks
+    size_t textc;
+    size_t textz;
+    VsubTplItem *items;
+    size_t itemc;
+    size_t itemz;
+    PtrArray names;      // unique zero terminated var names
+    StrMap index;        // var name -> names index, stored as vlen
+    size_t pending;      // var name index + 1 waiting for fallback, or 0
+    bool braced;         // pending var reference is ${NAME}
+    size_t inpc;         // parsed input length
+};
+
+#define VSUB_TPL_TEXT_MIN 256  // initial template text size
+#define VSUB_TPL_ITEM_MIN 16   // initial template item count
+
+
+// --- compilation
+
+static bool tpl_add_text(VsubTemplate *tpl, const char *str, size_t len) {
+    if (len == 0) {
+        return true;
+    }
+    if (tpl->textc + len > tpl->textz) {
+        size_t sz = tpl->textz ? tpl->textz : VSUB_TPL_TEXT_MIN;
+        while (sz < tpl->textc + len) {
+            sz *= 2;
+        }
+        char *newtext = realloc(tpl->text, sz);
+        if (!newtext) {
+            return false;
+        }
+        tpl->text = newtext;
+        tpl->textz = sz;
+    }
+    memcpy(tpl->text + tpl->textc, str, len);
+    tpl->textc += len;
+    return true;
+}
+
+static VsubTplItem *tpl_add_item(VsubTemplate *tpl) {
+    if (tpl->itemc == tpl->itemz) {
+        size_t count = tpl->itemz ? tpl->itemz * 2 : VSUB_TPL_ITEM_MIN;
+        VsubTplItem *newitems = realloc(tpl->items, count * sizeof(VsubTplItem));
+        if (!newitems) {
+            return NULL;
+        }
+        tpl->items = newitems;
+        tpl->itemz = count;
+    }
+    return &tpl->items[tpl->itemc++];
+}
+
+// var lookup while compiling: remember the name and report it unset, so that
+// the parser appends unset var fallback next; names are viewed in input, right
+// after '$' or '${'
+static const char *tpl_getvalue(Auxil *aux, const char *var, size_t len, size_t *vlen) {
+    VsubTemplate *tpl = aux->tpl;
+    *vlen = 0;
+    uint64_t hash = hash_str(var, len);
+    StrMapItem *item = map_find(&tpl->index, var, len, hash);
+    if (!item) {
+        char *name = malloc(len + 1);
+        bool found;
+        if (!name || !arr_append(&tpl->names, name)) {
+            free(name);
+            aux->sub->err = VSUB_ERR_MEMORY;
+            return NULL;
+        }
+        memcpy(name, var, len);
+        name[len] = '\0';
+        if (!(item = map_insert(&tpl->index, name, len, hash, &found))) {
+            aux->sub->err = VSUB_ERR_MEMORY;
+            return NULL;
+        }
+        item->vlen = tpl->names.count - 1;
+    }
+    tpl->pending = item->vlen + 1;
+    tpl->braced = (var[-1] == '{');
+    return NULL;
+}
+
+static bool tpl_append(Auxil *aux, size_t epos, const char *str, size_t len) {
+    VsubTemplate *tpl = aux->tpl;
+    VsubTplItem *last = tpl->itemc ? &tpl->items[tpl->itemc - 1] : NULL;
+    tpl->inpc = aux->sub->inpc = epos;
+    // merge adjacent literal texts
+    if (!tpl->pending && last && last->var == 0) {
+        last->len += len;
+        last->epos = epos;
+    }
+    else {
+        VsubTplItem *item = tpl_add_item(tpl);
+        if (!item) {
+            aux->sub->err = VSUB_ERR_MEMORY;
+            return false;
+        }
+        item->text = tpl->textc;
+        item->len = len;
+        item->var = tpl->pending;
+        item->epos = epos;
+        item->braced = tpl->pending && tpl->braced;
+        tpl->pending = 0;
+    }
+    if (!tpl_add_text(tpl, str, len)) {
+        aux->sub->err = VSUB_ERR_MEMORY;
+        return false;
+    }
+    return true;
+}
+
+VsubTemplate *vsub_compile(Vsub *sub) {
+    Auxil *aux = sub->aux;
+    VsubTemplate *tpl = malloc(sizeof(VsubTemplate));
+    if (!tpl) {
+        sub->err = VSUB_ERR_MEMORY;
+        return NULL;
+    }
+    tpl->text = NULL;
+    tpl->textc = tpl->textz = 0;
+    tpl->items = NULL;
+    tpl->itemc = tpl->itemz = 0;
+    arr_init(&tpl->names, &VSUB_ALLOC_LIBC);
+    map_init(&tpl->index, &VSUB_ALLOC_LIBC);
+    tpl->pending = 0;
+    tpl->braced = false;
+    tpl->inpc = 0;
+
+    // run parser with recording methods
+    const char *(*getvalue)(void *, const char *, size_t, size_t *) = aux->getvalue;
+    bool (*append_orig)(void *, size_t, const char *, size_t) = aux->append_orig;
+    bool (*append_subst)(void *, size_t, const char *, size_t) = aux->append_subst;
+    aux->getvalue = (const char *(*)(void *, const char *, size_t, size_t *))tpl_getvalue;
+    aux->append_orig = (bool (*)(void *, size_t, const char *, size_t))tpl_append;
+    aux->append_subst = (bool (*)(void *, size_t, const char *, size_t))tpl_append;
+    aux->tpl = tpl;
+    bool ok = vsub_run(sub);
+    aux->getvalue = getvalue;
+    aux->append_orig = append_orig;
+    aux->append_subst = append_subst;
+    aux->tpl = NULL;
+
+    if (!ok) {
+        vsub_discard(tpl);
+        return NULL;
+    }
+    sub->inpc = tpl->inpc;
+    return tpl;
+}
+
+void vsub_discard(VsubTemplate *tpl) {
+    if (tpl) {
+        for (size_t i = 0; i < tpl->names.count; i++) {
+            free(tpl->names.items[i]);
+        }
+        arr_free(&tpl->names);
+        map_free(&tpl->index);
+        free(tpl->items);
+        free(tpl->text);
+        free(tpl);
+    }
+}
+
+
+// --- rendering
+
+bool vsub_render(Vsub *sub, const VsubTemplate *tpl) {
+    Auxil *aux = sub->aux;
+    vsub_clear_results(sub);
+    vsub_clear_memo(sub);
+    aux->resn = 0;
+    // resolve every var once
+    if (aux->valz < tpl->names.count) {
+        VsubSpan *vals = MEM_REALLOC(sub->alloc, aux->vals, tpl->names.count * sizeof(VsubSpan));
+        if (!vals) {
+            sub->err = VSUB_ERR_MEMORY;
+            return false;
+        }
+        aux->vals = vals;
+        aux->valz = tpl->names.count;
+    }
+    for (size_t i = 0; i < tpl->names.count; i++) {
+        const char *name = tpl->names.items[i];
+        aux->vals[i].ptr = aux->getvalue(aux, name, strlen(name), &aux->vals[i].len);
+    }
+    // emit items
+    for (size_t i = 0; i < tpl->itemc; i++) {
+        const VsubTplItem *item = &tpl->items[i];
+        const VsubSpan *value = item->var ? &aux->vals[item->var - 1] : NULL;
+        if (value && value->ptr == VSUB_VALUE_KEEP) {
+            // original reference is $NAME or ${NAME}
+            const char *name = tpl->names.items[item->var - 1];
+            bool braced = item->braced;
+            aux->append_orig(aux, item->epos, braced ? "${" : "$", braced ? 2 : 1);
+            aux->append_orig(aux, item->epos, name, strlen(name));
+            if (braced) {
+                aux->append_orig(aux, item->epos, "}", 1);
+            }
+        }
+        else if (value && value->ptr) {
+            aux->append_subst(aux, item->epos, value->ptr, value->len);
+        }
+        else {
+            aux->append_orig(aux, item->epos, tpl->text + item->text, item->len);
+        }
+    }
+    return vsub_flush_results(sub);
+}
@@ -1,6 +1,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "util.h"
 
 
@@ -27,10 +28,11 @@ end:
 
 // simple pointer array
 
-void arr_init(PtrArray *arr) {
+void arr_init(PtrArray *arr, const VsubAllocator *alloc) {
   arr->items = NULL;
   arr->count = 0;
   arr->avail = 0;
+  arr->alloc = alloc;
 }
 
 bool arr_realloc(PtrArray *arr, size_t count) {
@@ -40,7 +42,7 @@ bool arr_realloc(PtrArray *arr, size_t count) {
     size_t extra = FIT(arr->count * ARR_EXTRA_FACTOR, ARR_MIN_EXTRA, ARR_MAX_EXTRA);
     size_t sz = (count + extra) * sizeof(void *);
     void *newitems = NULL;
-    if (!(newitems = realloc(arr->items, sz))) {
+    if (!(newitems = MEM_REALLOC(arr->alloc, arr->items, sz))) {
         return false;
     }
     arr->items = newitems;
@@ -49,7 +51,7 @@ bool arr_realloc(PtrArray *arr, size_t count) {
 }
 
 void arr_free(PtrArray *arr) {
-    free(arr->items);
+    MEM_FREE(arr->alloc, arr->items);
     arr->items = NULL;
     arr->count = arr->avail = 0;
 }
@@ -62,3 +64,90 @@ bool arr_append(PtrArray *arr, void *ptr) {
     arr->count++;
     return true;
 }
+
+
+// simple hash map
+
+uint64_t hash_str(const char *s, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+void map_init(StrMap *map, const VsubAllocator *alloc) {
+    map->items = NULL;
+    map->count = 0;
+    map->avail = 0;
+    map->alloc = alloc;
+}
+
+static StrMapItem *map_slot(const StrMap *map, const char *key, size_t klen, uint64_t hash) {
+    size_t mask = map->avail - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        StrMapItem *item = &map->items[i];
+        if (!item->key) {
+            return item;
+        }
+        if (item->hash == hash && item->klen == klen && memcmp(item->key, key, klen) == 0) {
+            return item;
+        }
+    }
+}
+
+bool map_realloc(StrMap *map, size_t count) {
+    if (count * 2 <= map->avail) {
+        return true;
+    }
+    size_t avail = MAP_MIN_AVAIL;
+    while (avail < count * 2) {
+        avail *= 2;
+    }
+    StrMap newmap = {MEM_ALLOC(map->alloc, avail * sizeof(StrMapItem)), map->count, avail, map->alloc};
+    if (!newmap.items) {
+        return false;
+    }
+    memset(newmap.items, 0, avail * sizeof(StrMapItem));
+    for (size_t i = 0; i < map->avail; i++) {
+        StrMapItem *item = &map->items[i];
+        if (item->key) {
+            *map_slot(&newmap, item->key, item->klen, item->hash) = *item;
+        }
+    }
+    MEM_FREE(map->alloc, map->items);
+    *map = newmap;
+    return true;
+}
+
+void map_free(StrMap *map) {
+    MEM_FREE(map->alloc, map->items);
+    map->items = NULL;
+    map->count = map->avail = 0;
+}
+
+StrMapItem *map_find(const StrMap *map, const char *key, size_t klen, uint64_t hash) {
+    if (map->count == 0) {
+        return NULL;
+    }
+    StrMapItem *item = map_slot(map, key, klen, hash);
+    return item->key ? item : NULL;
+}
+
+StrMapItem *map_insert(StrMap *map, const char *key, size_t klen, uint64_t hash, bool *found) {
+    if (!map_realloc(map, map->count + 1)) {
+        return NULL;
+    }
+    StrMapItem *item = map_slot(map, key, klen, hash);
+    *found = (item->key != NULL);
+    if (!*found) {
+        item->key = key;
+        item->klen = klen;
+        item->hash = hash;
+        item->val = NULL;
+        item->vlen = 0;
+        map->count++;
+    }
+    return item;
+}
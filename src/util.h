@@ -2,7 +2,9 @@
 #define VSUB_UTIL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include "vsub.h"
 
 
 // useful macros
@@ -13,6 +15,13 @@
 #define FIT(x,min,max) (MIN(MAX((x),(min)),(max)))
 
 
+// allocator calls
+
+#define MEM_ALLOC(a, size) ((a)->malloc((a)->data, (size)))
+#define MEM_REALLOC(a, ptr, size) ((a)->realloc((a)->data, (ptr), (size)))
+#define MEM_FREE(a, ptr) ((a)->free((a)->data, (ptr)))
+
+
 // dynamically growing sprintf
 
 char *asprintf(const char *format, ...);
@@ -24,16 +33,45 @@ typedef struct PtrArray {
     void **items;
     size_t count;
     size_t avail;
+    const VsubAllocator *alloc;
 } PtrArray;
 
 #define ARR_MIN_EXTRA 4
 #define ARR_EXTRA_FACTOR 2
 #define ARR_MAX_EXTRA 4096
 
-void arr_init(PtrArray *arr);
+void arr_init(PtrArray *arr, const VsubAllocator *alloc);
 bool arr_realloc(PtrArray *arr, size_t count);
 void arr_free(PtrArray *arr);
 bool arr_append(PtrArray *arr, void *ptr);
 
 
+// simple open addressing hash map with string keys
+
+uint64_t hash_str(const char *s, size_t len);  // FNV-1a
+
+typedef struct StrMapItem {
+    const char *key;  // NULL for empty slot
+    size_t klen;
+    uint64_t hash;
+    const char *val;
+    size_t vlen;      // value length or any other payload
+} StrMapItem;
+
+typedef struct StrMap {
+    StrMapItem *items;
+    size_t count;
+    size_t avail;     // power of 2, at least twice the count
+    const VsubAllocator *alloc;
+} StrMap;
+
+#define MAP_MIN_AVAIL 16
+
+void map_init(StrMap *map, const VsubAllocator *alloc);
+bool map_realloc(StrMap *map, size_t count);
+void map_free(StrMap *map);
+StrMapItem *map_find(const StrMap *map, const char *key, size_t klen, uint64_t hash);
+StrMapItem *map_insert(StrMap *map, const char *key, size_t klen, uint64_t hash, bool *found);
+
+
 #endif  // VSUB_UTIL_H
@@ -3,6 +3,7 @@
 #include "aux.h"
 #include "vsub.h"
 #include "vsubio.h"
+#include "engine/scan.h"
 #include "syntax/compose243.h"
 #include "syntax/envsubst.h"
 
@@ -37,6 +38,27 @@ const VsubSyntax *vsub_FindSyntax(const char *name) {
 }
 
 
+// --- engines
+
+const VsubEngine VSUB_ENGINES[] = {
+    {0, "packcc", "PackCC packrat parser"},       // 0 = VSUB_EN_PACKCC
+    {1, "scan", "SIMD scanner"},                  // 1 = VSUB_EN_SCAN
+};
+
+const VsubParser VSUB_SCANNER = PARSER(vsub_en_scan);
+
+const size_t VSUB_ENGINES_COUNT = sizeof(VSUB_ENGINES) / sizeof(VSUB_ENGINES[0]);
+
+const VsubEngine *vsub_FindEngine(const char *name) {
+    for (size_t i = 0; i < VSUB_ENGINES_COUNT; i++) {
+        if (strcmp(name, VSUB_ENGINES[i].name) == 0) {
+            return &VSUB_ENGINES[i];
+        }
+    }
+    return NULL;
+}
+
+
 // --- output formats
 
 const char *VSUB_FORMAT[] = {
@@ -75,12 +97,33 @@ const char *VSUB_ERRORS[] = {
 
 // --- memory management
 
+static void *libc_malloc(void *data, size_t size) {
+    (void)data;
+    return malloc(size);
+}
+
+static void *libc_realloc(void *data, void *ptr, size_t size) {
+    (void)data;
+    return realloc(ptr, size);
+}
+
+static void libc_free(void *data, void *ptr) {
+    (void)data;
+    free(ptr);
+}
+
+const VsubAllocator VSUB_ALLOC_LIBC = {libc_malloc, libc_realloc, libc_free, NULL, NULL};
+
+// grow geometrically, so that appending n bytes costs amortized O(n)
 static bool aux_request_resbuf(Auxil *aux, size_t sz) {
     if (sz <= aux->resz) {
         return true;
     }
-    size_t newsz = sz + VSUB_BRES_INC;
-    char *newbuf = realloc(aux->resbuf, sz);
+    size_t newsz = aux->resz + MIN(aux->resz, VSUB_BRES_MAX_INC);
+    if (newsz < sz) {
+        newsz = sz;
+    }
+    char *newbuf = MEM_REALLOC(aux->sub->alloc, aux->resbuf, newsz);
     if (!newbuf) {
         aux->sub->err = VSUB_ERR_MEMORY;
         return false;
@@ -94,7 +137,7 @@ static bool aux_request_errbuf(Auxil *aux, size_t sz) {
     if (sz <= aux->errz) {
         return true;
     }
-    char *newbuf = realloc(aux->errbuf, sz);
+    char *newbuf = MEM_REALLOC(aux->sub->alloc, aux->errbuf, sz);
     if (!newbuf) {
         aux->sub->err = VSUB_ERR_MEMORY;
         return false;
@@ -107,25 +150,87 @@ static bool aux_request_errbuf(Auxil *aux, size_t sz) {
 
 // --- aux parser api
 
+static size_t aux_read(Auxil *aux, char *buf, size_t n) {
+    Vsub *sub = aux->sub;
+    if (sub->maxinp > 0 && sub->gcbc + n > sub->maxinp) {
+        n = sub->maxinp - sub->gcbc;
+        if (n == 0) {
+            // input is cut only if there is more of it
+            char c;
+            sub->trunc = ((VsubTextSrc*)(sub->tsrc))->read(sub->tsrc, &c, 1) > 0;
+            aux->eof = true;
+            return 0;
+        }
+    }
+    sub->gcac += n;
+    size_t got = ((VsubTextSrc*)(sub->tsrc))->read(sub->tsrc, buf, n);
+    sub->gcbc += got;
+    aux->eof = (got == 0);
+    return got;
+}
+
+static bool aux_view(Auxil *aux, const char **ptr, size_t *len) {
+    Vsub *sub = aux->sub;
+    VsubTextSrc *tsrc = sub->tsrc;
+    if (!tsrc->view || !tsrc->view(tsrc, ptr, len)) {
+        return false;
+    }
+    if (sub->maxinp > 0 && sub->gcbc + *len > sub->maxinp) {
+        *len = sub->maxinp - sub->gcbc;
+        sub->trunc = true;
+    }
+    sub->gcac += *len;
+    sub->gcbc += *len;
+    aux->eof = true;
+    return true;
+}
+
+// input of the atom being parsed is kept at the start of the next block, so
+// that input read ahead can be given back to a new parser context
 static int aux_getchar(Auxil *aux) {
-    aux->sub->gcac++;
-    if (aux->sub->maxinp == 0 || aux->sub->gcac < aux->sub->maxinp) {
-        int c = ((VsubTextSrc*)(aux->sub->tsrc))->getchar(aux->sub->tsrc);
-        if (c >= 0) {
-            aux->sub->gcbc++;
+    if (aux->eof) {
+        return -1;  // parsers probe the end repeatedly, source is not read again
+    }
+    size_t keep = aux->inpo + aux->inpn - aux->sub->inpc;
+    aux->inpo += aux->inpn - keep;
+    aux->inpi = keep;
+    if (keep > 0 || !aux_view(aux, &aux->inp, &aux->inpn)) {
+        if (!aux->inpbuf) {
+            if (!(aux->inpbuf = MEM_ALLOC(aux->sub->alloc, VSUB_BINP_SIZE))) {
+                aux->sub->err = VSUB_ERR_MEMORY;
+                return -1;
+            }
+            aux->inpz = VSUB_BINP_SIZE;
+        }
+        if (aux->inpz < keep + VSUB_BINP_SIZE / 2) {  // long atom
+            char *newbuf = MEM_REALLOC(aux->sub->alloc, aux->inpbuf, keep + VSUB_BINP_SIZE);
+            if (!newbuf) {
+                aux->sub->err = VSUB_ERR_MEMORY;
+                return -1;
+            }
+            aux->inpbuf = newbuf;
+            aux->inpz = keep + VSUB_BINP_SIZE;
         }
-        return c;
+        memmove(aux->inpbuf, aux->inpbuf + aux->inpn - keep, keep);  // block with kept input is buffered
+        aux->inp = aux->inpbuf;
+        aux->inpn = keep + aux_read(aux, aux->inpbuf + keep, aux->inpz - keep);
     }
-    else {
-        aux->sub->trunc = true;
+    if (aux->inpi == aux->inpn) {
         return -1;
     }
+    return (unsigned char)aux->inp[aux->inpi++];
 }
 
-static const char *aux_getvalue(Auxil *aux, const char *var) {
+const char VSUB_VALUE_KEEP[] = "";
+
+static const char *aux_lookup(Auxil *aux, const char *var, size_t len, size_t *vlen) {
+    *vlen = 0;
+    if (aux->sub->only && !vsub_AllowsVar(aux->sub->only, var, len)) {
+        return VSUB_VALUE_KEEP;  // sources are not searched
+    }
     VsubVarsSrc *vsrc = aux->sub->vsrc;
     while (vsrc) {
-        const char *value = vsrc->getvalue(vsrc, var);
+        const char *value = vsrc->getvalue(vsrc, var, len, vlen);
         if (value) {
             return value;
         }
@@ -136,45 +241,111 @@ static const char *aux_getvalue(Auxil *aux, const char *var) {
     return NULL;
 }
 
-static bool aux_append(Auxil *aux, int epos, char *str) {
+// repeated names are resolved with one probe; colliding names replace each other
+static const char *aux_getvalue(Auxil *aux, const char *var, size_t len, size_t *vlen) {
+    if (len > VSUB_MEMO_NAME) {
+        return aux_lookup(aux, var, len, vlen);
+    }
+    uint64_t hash = hash_str(var, len);
+    VsubMemo *m = &aux->memo[(hash ^ (hash >> 32)) & (VSUB_MEMO_SIZE - 1)];
+    if (m->gen == aux->memogen && m->len == len && memcmp(m->name, var, len) == 0) {
+        *vlen = m->vlen;
+        return m->value;
+    }
+    m->value = aux_lookup(aux, var, len, vlen);
+    m->vlen = *vlen;
+    m->gen = aux->memogen;
+    m->len = (unsigned char)len;
+    memcpy(m->name, var, len);
+    return m->value;
+}
+
+static bool aux_write(Auxil *aux, const char *str, size_t len) {
+    VsubSink *snk = aux->sub->sink;
+    if (!snk->write(snk, str, len)) {
+        aux->sub->err = VSUB_ERR_FILE_WRITE;
+        return false;
+    }
+    return true;
+}
+
+static bool aux_flush(Auxil *aux) {
+    size_t n = aux->resn;
+    aux->resn = 0;
+    return n == 0 || aux_write(aux, aux->resbuf, n);
+}
+
+// buffer output for sink; spans not fitting into the buffer are written directly
+static bool aux_emit(Auxil *aux, const char *str, size_t len) {
+    // result buffer is small if sink was set after vsub_alloc
+    if (aux->resn + len > aux->resz && aux->resz < VSUB_BOUT_SIZE) {
+        if (!aux_request_resbuf(aux, VSUB_BOUT_SIZE)) {
+            return false;
+        }
+    }
+    if (aux->resn + len > aux->resz) {
+        if (!aux_flush(aux)) {
+            return false;
+        }
+        if (len >= aux->resz) {
+            return aux_write(aux, str, len);
+        }
+    }
+    memcpy(aux->resbuf + aux->resn, str, len);
+    aux->resn += len;
+    return true;
+}
+
+static bool aux_append(Auxil *aux, size_t epos, const char *str, size_t len) {
     Vsub *sub = aux->sub;
-    sub->res = aux->resbuf;  // make non-NULL on first append
+    if (!sub->sink && !sub->res) {
+        sub->res = aux->resbuf;  // make non-NULL on first append
+        sub->res[0] = '\0';
+    }
     sub->inpc = epos;
     size_t current = sub->resc;
-    size_t required = sub->resc + strlen(str);
+    size_t required = sub->resc + len;
     size_t allowed = required;
     if (sub->maxres > 0 && sub->maxres < required) {
         allowed = sub->maxres;
     }
-    int delta = allowed - current;
+    size_t delta = allowed - current;
     if (allowed < required) {
         sub->trunc = true;
     }
-    if (delta <= 0) {
+    if (delta == 0) {
         return false;
     }
+    if (sub->sink) {
+        if (!aux_emit(aux, str, delta)) {
+            return false;
+        }
+        sub->resc += delta;
+        return true;
+    }
     if (!aux_request_resbuf(sub->aux, allowed + 1)) {
         return false;
     }
-    char *end = stpncpy(sub->res + current, str, delta);
-    *end = '\0';
+    sub->res = aux->resbuf;  // might be moved
+    memcpy(sub->res + current, str, delta);
+    sub->res[current + delta] = '\0';
     sub->resc += delta;
     return true;
 }
 
-static bool aux_append_orig(Auxil *aux, int epos, char *str) {
-    return aux_append(aux, epos, str);
+static bool aux_append_orig(Auxil *aux, size_t epos, const char *str, size_t len) {
+    return aux_append(aux, epos, str, len);
 }
 
-static bool aux_append_subst(Auxil *aux, int epos, char *str) {
-    if (!aux_append(aux, epos, str)) {
+static bool aux_append_subst(Auxil *aux, size_t epos, const char *str, size_t len) {
+    if (!aux_append(aux, epos, str, len)) {
         return false;
     }
     aux->sub->subc++;
     return true;
 }
 
-static bool aux_append_error(Auxil *aux, int epos, char *var, char *msg) {
+static bool aux_append_error(Auxil *aux, size_t epos, char *var, char *msg) {
     aux->sub->errvar = aux->errbuf;  // make non-NULL when error is set
     aux->sub->inpc = epos;
     if (!aux_request_errbuf(aux, strlen(var) + strlen(msg) + 2)) {
@@ -189,7 +360,14 @@ static bool aux_append_error(Auxil *aux, int epos, char *var, char *msg) {
 
 // -- vsub user api
 
-static void vsub_clear_results(Vsub *sub) {
+bool vsub_flush_results(Vsub *sub) {
+    if (sub->sink && sub->err == VSUB_SUCCESS) {
+        aux_flush(sub->aux);
+    }
+    return sub->err == VSUB_SUCCESS;
+}
+
+void vsub_clear_results(Vsub *sub) {
     sub->res = NULL;
     sub->err = VSUB_SUCCESS;
     sub->errvar = NULL;
@@ -203,39 +381,74 @@ static void vsub_clear_results(Vsub *sub) {
     sub->iterc = 0;
 }
 
+void vsub_clear_memo(Vsub *sub) {
+    Auxil *aux = sub->aux;
+    if (++aux->memogen == 0) {  // wrapped, stale entries would become current
+        memset(aux->memo, 0, sizeof(aux->memo));
+        aux->memogen = 1;
+    }
+}
+
 bool vsub_init(Vsub *sub) {
+    return vsub_init_alloc(sub, &VSUB_ALLOC_LIBC);
+}
+
+bool vsub_init_alloc(Vsub *sub, const VsubAllocator *alloc) {
     // vsub params
     sub->syntax = &VSUB_SYNTAXES[VSUB_SX_ENVSUBST];
+    sub->engine = &VSUB_ENGINES[VSUB_EN_SCAN];  // same results as packcc without memoization
     sub->depth = 1;
     sub->maxinp = 0;
     sub->maxres = 0;
+    sub->threads = 1;
+    sub->only = NULL;
+    sub->alloc = alloc;
     // sources
     sub->tsrc = NULL;
     sub->vsrc = NULL;
+    sub->sink = NULL;
     // vsub result
     vsub_clear_results(sub);
 
     // aux
-    Auxil *aux = malloc(sizeof(Auxil));
+    Auxil *aux = MEM_ALLOC(alloc, sizeof(Auxil));
+    sub->aux = aux;
     if (!aux) {
         return false;
     }
     aux->sub = sub;
-    sub->aux = aux;
     // aux syntax methods
     aux->getchar = (int (*)(void *))aux_getchar;
-    aux->getvalue = (const char *(*)(void *, const char *))aux_getvalue;
-    aux->append_orig = (bool (*)(void *, int, const char *))aux_append_orig;
-    aux->append_subst = (bool (*)(void *, int, const char *))aux_append_subst;
-    aux->append_error = (bool (*)(void *, int, const char *, const char *))aux_append_error;
+    aux->read = (size_t (*)(void *, char *, size_t))aux_read;
+    aux->view = (bool (*)(void *, const char **, size_t *))aux_view;
+    aux->getvalue = (const char *(*)(void *, const char *, size_t, size_t *))aux_getvalue;
+    aux->append_orig = (bool (*)(void *, size_t, const char *, size_t))aux_append_orig;
+    aux->append_subst = (bool (*)(void *, size_t, const char *, size_t))aux_append_subst;
+    aux->append_error = (bool (*)(void *, size_t, const char *, const char *))aux_append_error;
     // data
+    aux->inp = NULL;
+    aux->inpn = aux->inpi = aux->inpo = 0;
+    aux->inpbuf = NULL;
+    aux->inpz = 0;
+    aux->eof = false;
     aux->resbuf = NULL;
     aux->resz = VSUB_BRES_MIN;
+    aux->resn = 0;
     aux->errbuf = NULL;
     aux->errz = VSUB_BERR_MIN;
     // parser
     aux->parser = NULL;
     aux->pctx = NULL;
+    aux->base = 0;
+    vsub_pool_init(aux);
+    // templates
+    aux->tpl = NULL;
+    aux->vals = NULL;
+    aux->valz = 0;
+    aux->refs = NULL;
+    // var lookups
+    memset(aux->memo, 0, sizeof(aux->memo));
+    aux->memogen = 0;
 
     return true;
 }
@@ -244,73 +457,153 @@ bool vsub_alloc(Vsub *sub) {
     // result and error buffers
     Auxil *aux = sub->aux;
     if (!aux->resbuf) {
-        if (!(aux->resbuf = malloc(aux->resz))) {
+        if (sub->sink) {
+            aux->resz = VSUB_BOUT_SIZE;
+        }
+        if (!(aux->resbuf = MEM_ALLOC(sub->alloc, aux->resz))) {
             sub->err = VSUB_ERR_MEMORY;
             return false;
         }
     }
     if (!aux->errbuf) {
-        if (!(aux->errbuf = malloc(aux->errz))) {
+        if (!(aux->errbuf = MEM_ALLOC(sub->alloc, aux->errz))) {
             sub->err = VSUB_ERR_MEMORY;
             return false;
         }
     }
-    // parser
-    aux->parser = &VSUB_PARSERS[sub->syntax->id];
-    if (!aux->pctx) {
-        if (!(aux->pctx = aux->parser->create(aux))) {
-            sub->err = VSUB_ERR_MEMORY;
-            return false;
-        }
+    return true;
+}
+
+static bool vsub_alloc_parser(Vsub *sub) {
+    Auxil *aux = sub->aux;
+    if (aux->pctx) {
+        return true;
+    }
+    if (sub->engine->id == VSUB_EN_SCAN) {
+        aux->parser = &VSUB_SCANNER;
+    }
+    else {
+        aux->parser = &VSUB_PARSERS[sub->syntax->id];
+    }
+    if (!(aux->pctx = aux->parser->create(aux))) {
+        sub->err = VSUB_ERR_MEMORY;
+        return false;
     }
     return true;
 }
 
+// parser context state is unknown after failure, so it is recreated on next run
+static void vsub_free_parser(Vsub *sub) {
+    Auxil *aux = sub->aux;
+    if (aux->pctx) {
+        aux->parser->destroy(aux->pctx);
+        aux->pctx = NULL;
+    }
+}
+
 void vsub_free(Vsub *sub) {
     Auxil *aux = sub->aux;
     if (aux) {
         // parser context
-        if (aux->parser) {
-            aux->parser->destroy(aux->pctx);
-        }
+        vsub_free_parser(sub);
+        vsub_pool_release(aux);
+        vsub_free_refs(sub);
         // aux
-        free(aux->resbuf);
+        MEM_FREE(sub->alloc, aux->inpbuf);
+        MEM_FREE(sub->alloc, aux->resbuf);
         sub->res = NULL;
-        free(aux->errbuf);
+        MEM_FREE(sub->alloc, aux->errbuf);
         sub->errvar = sub->errmsg = NULL;
-        free(aux);
+        MEM_FREE(sub->alloc, aux->vals);
+        MEM_FREE(sub->alloc, aux);
         sub->aux = NULL;
     }
     // input text source
-    free(sub->tsrc);
-    sub->tsrc = NULL;
+    vsub_CloseTextSrc(sub);
+    // output sink
+    vsub_CloseSink(sub);
     // input vars sources
-    VsubVarsSrc *vsrc = sub->vsrc;
-    while (vsrc != NULL) {
-        VsubVarsSrc *prev = vsrc->prev;
-        free(vsrc);
-        vsrc = prev;
+    vsub_CloseVarsSrc(sub);
+    // allocator
+    if (sub->alloc && sub->alloc->release) {
+        sub->alloc->release(sub->alloc->data);
     }
-    sub->vsrc = NULL;
+    sub->alloc = &VSUB_ALLOC_LIBC;  // released allocator is not used again
 }
 
-bool vsub_run(Vsub *sub) {
+// single pass; successful parse must have reached the end of input and
+// reported every byte read as parsed
+static bool vsub_parse(Vsub *sub) {
     Auxil *aux = sub->aux;
-    vsub_clear_results(sub);
-    // first pass
-    int ret = aux->parser->parse(aux->pctx, NULL);
-    if (sub->err != VSUB_SUCCESS) {  // failed
-        return false;
+    // top rule is a single atom, so parsed input is committed after every atom;
+    // packcc context still indexes LR table by absolute input position, so it
+    // is recreated at atom boundary, keeping memory bounded; input it has read
+    // ahead is still in the input block and is read again by the new context
+    while (aux->parser->parse(aux->pctx, NULL) && sub->err == VSUB_SUCCESS) {
+        size_t pos = sub->inpc;
+        if (aux->parser != &VSUB_SCANNER && pos - aux->base >= VSUB_PCTX_SPAN) {
+            vsub_free_parser(sub);
+            aux->inpi = pos - aux->inpo;
+            aux->base = pos;
+            if (!vsub_alloc_parser(sub)) {
+                return false;
+            }
+        }
     }
-    else if (ret == 0) {  // all consumed
-        return true;
+    if (sub->err != VSUB_SUCCESS) {
+        return false;
     }
-    // second pass
-    int resc = sub->resc;
-    ret = aux->parser->parse(aux->pctx, NULL);  // second pass
-    if (ret > 0 || resc < sub->resc || sub->err != VSUB_SUCCESS) {
-        sub->err = VSUB_ERR_PARSER;
+    if (!aux->eof || sub->inpc != sub->gcbc) {
+        sub->err = VSUB_ERR_PARSER;  // input left unparsed
         return false;
     }
     return true;
 }
+
+// buffers keep their size, buffered input and output are dropped
+static void vsub_clear_state(Vsub *sub) {
+    Auxil *aux = sub->aux;
+    vsub_clear_results(sub);
+    vsub_clear_memo(sub);
+    aux->inpn = aux->inpi = aux->inpo = 0;
+    aux->eof = false;
+    aux->base = 0;
+    aux->resn = 0;
+}
+
+// parser context is inconsistent after out of memory, so it is dropped with
+// all pooled memory
+static bool vsub_parse_guarded(Vsub *sub) {
+    Auxil *aux = sub->aux;
+    if (setjmp(aux->oom) != 0) {
+        aux->pctx = NULL;
+        vsub_pool_release(aux);
+        sub->err = VSUB_ERR_MEMORY;
+        return false;
+    }
+    return vsub_alloc_parser(sub) && vsub_parse(sub);
+}
+
+bool vsub_run(Vsub *sub) {
+    Auxil *aux = sub->aux;
+    vsub_clear_state(sub);
+    // result truncation and template compilation depend on serial order
+    const char *ptr;
+    size_t len;
+    if (sub->threads != 1 && sub->maxres == 0 && !aux->tpl && aux->view(aux, &ptr, &len)) {
+        return vsub_run_chunks(sub, ptr, len);
+    }
+    bool ok = vsub_parse_guarded(sub);
+    // packcc context indexes LR table by absolute input position, so reused
+    // context keeps growing it; it is recreated from pooled memory instead
+    if (!ok || aux->parser != &VSUB_SCANNER) {
+        vsub_free_parser(sub);
+    }
+    return ok && vsub_flush_results(sub);
+}
+
+bool vsub_reset(Vsub *sub) {
+    vsub_clear_state(sub);
+    VsubTextSrc *tsrc = sub->tsrc;
+    return !tsrc || (tsrc->reset && tsrc->reset(tsrc));
+}
@@ -33,16 +33,54 @@ extern const VsubSyntax VSUB_SYNTAXES[];  // using VSUB_SX_* as indexes
 extern const size_t VSUB_SYNTAXES_COUNT;
 
 
+// --- engines
+
+typedef struct VsubEngine {
+    const int id;
+    const char *name;
+    const char *title;
+} VsubEngine;
+
+VSUB_EXPORT const VsubEngine *vsub_FindEngine(const char *name);  // find by name
+
+#define VSUB_EN_PACKCC 0
+#define VSUB_EN_SCAN 1
+
+extern const VsubEngine VSUB_ENGINES[];  // using VSUB_EN_* as indexes
+extern const size_t VSUB_ENGINES_COUNT;
+
+
+// --- memory allocation
+
+// allocator of context memory; contexts rendering on threads share it, so it
+// must be thread safe when threads param or batch rendering is used
+typedef struct VsubAllocator {
+    void *(*malloc)(void *data, size_t size);  // NULL if out of memory
+    void *(*realloc)(void *data, void *ptr, size_t size);  // NULL if out of memory
+    void (*free)(void *data, void *ptr);
+    void (*release)(void *data);  // optional, frees all memory at vsub_free; can be NULL
+    void *data;
+} VsubAllocator;
+
+extern const VsubAllocator VSUB_ALLOC_LIBC;  // default allocator
+
+
 // --- substitution context
 
+typedef struct VsubAllowlist VsubAllowlist;  // see var allowlists
+
 typedef struct Vsub {
     // params
     const VsubSyntax *syntax;  // default: VSUB_SX_ENVSUBST
+    const VsubEngine *engine;  // default: VSUB_EN_SCAN
     char depth;     // max subst iter count; default: 1
-    size_t maxinp;  // max length of input string; unlimited if set to 0
+    size_t maxinp;  // max input bytes, longer input is cut; unlimited if set to 0
     size_t maxres;  // max length of result string; unlimited if set to 0
+    size_t threads; // render mapped input in chunks on threads, 0 for one per CPU; default: 1
+    const VsubAllowlist *only;  // substitute listed vars only, others kept as is; default: NULL
+    const VsubAllocator *alloc;  // memory of context, its sources and sinks; set by init
     // result
-    char *res;      // result string
+    char *res;      // result string of resc bytes, zero terminated; NULL if written to output sink
     int err;        // see error/success flags
     char *errvar;   // first variable name with error; default: NULL
     char *errmsg;   // variable error message; default: NULL
@@ -56,24 +94,124 @@ typedef struct Vsub {
     // internal data
     void *tsrc;
     void *vsrc;
+    void *sink;
     void *aux;
 } Vsub;
 
 VSUB_EXPORT bool vsub_init(Vsub *sub);
-VSUB_EXPORT bool vsub_alloc(Vsub *sub);
+VSUB_EXPORT bool vsub_init_alloc(Vsub *sub, const VsubAllocator *alloc);  // borrowed
+VSUB_EXPORT bool vsub_init_arena(Vsub *sub, size_t block);  // bump arena, 0 for default block size
+VSUB_EXPORT bool vsub_alloc(Vsub *sub);  // parser context is created by vsub_run
 VSUB_EXPORT bool vsub_run(Vsub *sub);
+VSUB_EXPORT bool vsub_reset(Vsub *sub);  // clear results and rewind text source; false if not rewindable
 VSUB_EXPORT cJSON *vsub_results(const Vsub *sub, bool include_details);
-VSUB_EXPORT void vsub_free(Vsub *sub);
+VSUB_EXPORT void vsub_free(Vsub *sub);  // also safe for zeroed context
+
+
+// --- thread safety
+
+// Vsub is per-thread render state: functions taking Vsub can run concurrently
+// on different Vsub objects, but a single Vsub must not be shared by threads.
+// Objects below are immutable once created and can be shared by any number of
+// threads and Vsub objects, as long as they outlive them: syntax and engine
+// tables, compiled templates, var tables, and var allowlists.
+
+
+// --- compiled templates
+
+typedef struct VsubTemplate VsubTemplate;
+
+VSUB_EXPORT VsubTemplate *vsub_compile(Vsub *sub);  // parse text source once; NULL on error
+VSUB_EXPORT bool vsub_render(Vsub *sub, const VsubTemplate *tpl);  // substitute vars of sub
+VSUB_EXPORT void vsub_discard(VsubTemplate *tpl);
+
+
+// --- shared var tables
+
+typedef struct VsubVarTable VsubVarTable;
+
+VSUB_EXPORT VsubVarTable *vsub_ShareVars(Vsub *sub);  // copy enumerable vars of sub; NULL on error
+VSUB_EXPORT bool vsub_UseVarsFromTable(Vsub *sub, const VsubVarTable *table);  // borrowed
+VSUB_EXPORT void vsub_FreeVarTable(VsubVarTable *table);
+
+
+// --- var allowlists
+
+// borrowed by Vsub only param
+VSUB_EXPORT VsubAllowlist *vsub_CompileAllowlist(size_t c, const char *names[]);  // NULL on error
+VSUB_EXPORT bool vsub_AllowsVar(const VsubAllowlist *list, const char *var, size_t len);
+VSUB_EXPORT void vsub_FreeAllowlist(VsubAllowlist *list);
+
+
+// --- var references
+
+typedef struct VsubVarRef {
+    const char *name;  // zero terminated var name
+    size_t count;      // number of references
+    size_t first;      // input offset of the first reference
+} VsubVarRef;
+
+// list vars referenced by text source of sub, deduplicated in order of first
+// reference; input is read once without rendering, refs are owned by sub until
+// next scan or vsub_free; returns false on error, see sub->err
+VSUB_EXPORT bool vsub_scan_vars(Vsub *sub, const VsubVarRef **refs, size_t *count);
+
+
+// --- batch rendering
+
+typedef struct VsubJob {
+    const char *text;          // zero terminated input; NULL to read input file
+    const char *path;          // input file path, used if text is NULL
+    const VsubVarTable *vars;  // shared var table; NULL if there are no vars
+    bool (*write)(void *data, const char *buf, size_t n);  // output sink; NULL to use output file
+    void *data;                // output sink data
+    const char *outpath;       // output file path, used if write is NULL; NULL to return result
+} VsubJob;
+
+typedef struct VsubJobResult {
+    char *res;      // copy of result string; NULL if written to sink, output file, or empty
+    int err;        // see error/success flags; VSUB_ERR_MEMORY if job was not run
+    char *errvar;   // copy of first variable name with error; default: NULL
+    char *errmsg;   // variable error message, allocated with errvar
+    bool trunc;     // whether result string was truncated because of maxinp or maxres
+    size_t inpc;    // parsed input length; also serves as error location
+    size_t resc;    // actual length of result str
+    size_t subc;    // count of total substitutions made
+} VsubJobResult;
+
+// run jobs on a pool of threads, using 0 for one thread per CPU; params of sub
+// apply to all jobs, its sources are ignored; sinks are called from pool threads;
+// file open errors are VSUB_ERR_FILE_OPEN for input and VSUB_ERR_FILE_WRITE for
+// output, output file is removed if job fails; returns whether all jobs succeeded
+VSUB_EXPORT bool vsub_run_batch(const Vsub *sub, const VsubJob *jobs, VsubJobResult *results,
+    size_t count, size_t threads);
+VSUB_EXPORT void vsub_free_batch(VsubJobResult *results, size_t count);  // free result copies
 
 
 // --- input sources
 
 VSUB_EXPORT bool vsub_UseTextFromFile(Vsub *sub, FILE *fp);
+VSUB_EXPORT bool vsub_UseTextFromMmap(Vsub *sub, int fd);  // regular files only
 VSUB_EXPORT bool vsub_UseTextFromStr(Vsub *sub, const char *s);
+VSUB_EXPORT bool vsub_UseTextFromBuf(Vsub *sub, const char *ptr, size_t len);  // may contain any bytes
+// rebind current source of the same kind in place, or use a new one
+VSUB_EXPORT bool vsub_SetTextFromFile(Vsub *sub, FILE *fp);
+VSUB_EXPORT bool vsub_SetTextFromStr(Vsub *sub, const char *s);
+VSUB_EXPORT bool vsub_SetTextFromBuf(Vsub *sub, const char *ptr, size_t len);
 
 VSUB_EXPORT bool vsub_UseVarsFromArrays(Vsub *sub, size_t c, const char *k[], const char *v[]);
-VSUB_EXPORT bool vsub_UseVarsFromEnv(Vsub *sub);
+VSUB_EXPORT bool vsub_UseVarsFromEnv(Vsub *sub);  // live, never frozen or shared; snapshot can be
+VSUB_EXPORT bool vsub_UseVarsFromEnvSnapshot(Vsub *sub, const char *prefix);  // prefix may be NULL
 VSUB_EXPORT bool vsub_UseVarsFromKvarray(Vsub *sub, size_t c, const char *kv[]);
+VSUB_EXPORT bool vsub_FreezeVars(Vsub *sub);  // merge enumerable vars sources added so far, copying vars
+
+
+// --- output sinks
+
+VSUB_EXPORT bool vsub_UseSink(Vsub *sub, bool (*write)(void *data, const char *buf, size_t n), void *data);
+VSUB_EXPORT bool vsub_UseSinkFd(Vsub *sub, int fd);
+VSUB_EXPORT bool vsub_UseSinkFile(Vsub *sub, FILE *fp);
+VSUB_EXPORT bool vsub_UseSinkMem(Vsub *sub, char **buf, size_t *len);  // caller frees *buf
 
 
 // --- output formats
@@ -82,6 +220,8 @@ VSUB_EXPORT int vsub_FindFormat(const char *name);
 VSUB_EXPORT int vsub_OutputPlain(Vsub *sub, FILE *fp);
 VSUB_EXPORT int vsub_OutputJson(Vsub *sub, FILE *fp, bool detailed);
 VSUB_EXPORT int vsub_OutputPretty(Vsub *sub, FILE *fp, bool result, bool detailed);
+VSUB_EXPORT int vsub_OutputVarsPlain(const VsubVarRef *refs, size_t count, FILE *fp);  // name, count, first
+VSUB_EXPORT int vsub_OutputVarsJson(const VsubVarRef *refs, size_t count, FILE *fp);
 
 #define VSUB_FMT_PLAIN 0
 #define VSUB_FMT_JSON 1
@@ -1,15 +1,54 @@
 #include <stdlib.h>
+#include "util.h"
 #include "vsubio.h"
 
 
 void vsub_SetTextSrc(Vsub *sub, VsubTextSrc *src) {
-    if (sub->tsrc) {
-        free(sub->tsrc);
-    }
+    vsub_CloseTextSrc(sub);
     sub->tsrc = src;
 }
 
+void vsub_CloseTextSrc(Vsub *sub) {
+    VsubTextSrc *src = sub->tsrc;
+    if (src) {
+        if (src->close) {
+            src->close(src);
+        }
+        MEM_FREE(sub->alloc, src);
+    }
+    sub->tsrc = NULL;
+}
+
 void vsub_AddVarsSrc(Vsub *sub, VsubVarsSrc *src) {
     src->prev = sub->vsrc;
     sub->vsrc = src;
 }
+
+void vsub_CloseVarsSrc(Vsub *sub) {
+    VsubVarsSrc *src = sub->vsrc;
+    while (src) {
+        VsubVarsSrc *prev = src->prev;
+        if (src->close) {
+            src->close(src);
+        }
+        MEM_FREE(sub->alloc, src);
+        src = prev;
+    }
+    sub->vsrc = NULL;
+}
+
+void vsub_SetSink(Vsub *sub, VsubSink *snk) {
+    vsub_CloseSink(sub);
+    sub->sink = snk;
+}
+
+void vsub_CloseSink(Vsub *sub) {
+    VsubSink *snk = sub->sink;
+    if (snk) {
+        if (snk->close) {
+            snk->close(snk);
+        }
+        MEM_FREE(sub->alloc, snk);
+    }
+    sub->sink = NULL;
+}
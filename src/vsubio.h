@@ -6,18 +6,41 @@
 
 typedef struct VsubTextSrc {
     const char *name;
-    int (*getchar)(void *src);
+    size_t (*read)(void *src, char *buf, size_t n);  // returns 0 at EOF
+    // optional methods, can be NULL
+    bool (*view)(void *src, const char **ptr, size_t *len);  // consume the rest in place
+    bool (*reset)(void *src);  // rewind to the start of input
+    void (*close)(void *src);  // release resources before the source is freed
 } VsubTextSrc;
 
+typedef bool (*VsubVarFn)(void *data, const char *key, size_t klen, const char *val, size_t vlen);
+
 typedef struct VsubVarsSrc {
     const char *name;
-    const char *(*getvalue)(void *src, const char *var);
+    // var isn't zero terminated; sets value length, values may contain zero bytes
+    const char *(*getvalue)(void *src, const char *var, size_t len, size_t *vlen);
+    // optional methods, can be NULL
+    bool (*each)(void *src, VsubVarFn fn, void *data);  // enumerate vars until fn fails
+    void (*close)(void *src);  // release resources before the source is freed
     void *prev;
 } VsubVarsSrc;
 
+typedef struct VsubSink {
+    const char *name;
+    bool (*write)(void *snk, const char *buf, size_t n);  // writes all bytes or fails
+    // optional methods, can be NULL
+    void (*close)(void *snk);  // release resources before the sink is freed
+} VsubSink;
+
 // input helpers
 void vsub_SetTextSrc(Vsub *sub, VsubTextSrc *src);
+void vsub_CloseTextSrc(Vsub *sub);
 void vsub_AddVarsSrc(Vsub *sub, VsubVarsSrc *src);
+void vsub_CloseVarsSrc(Vsub *sub);  // close all vars sources
+
+// output helpers
+void vsub_SetSink(Vsub *sub, VsubSink *snk);
+void vsub_CloseSink(Vsub *sub);
 
 
 #endif  // VSUB_IO_H
@@ -0,0 +1,450 @@
+// rendering throughput on synthetic templates, reported as JSON
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cjson/cJSON.h>
+#include "vsub.h"
+#include "vsubio.h"
+
+
+#define KB ((size_t)1024)
+#define MB (KB * 1024)
+#define GB (MB * 1024)
+
+static const size_t SIZES[] = {KB, 32 * KB, MB, 32 * MB, GB};
+static const size_t VARS[] = {1, 100, 10000, 100000};
+
+#define BENCH_VARS 100        // var set size when benchmarking input sizes
+#define BENCH_VARS_SIZE MB    // input size when benchmarking var set sizes
+
+
+// --- synthetic templates
+
+typedef struct Pattern {
+    const char *name;
+    const char *fmt;  // atom format, takes var index twice
+} Pattern;
+
+static const Pattern PATTERNS[] = {
+    {"plain", "lorem ipsum dolor sit amet, "},
+    {"dense", "$V%zu $V%zu "},
+    {"braced", "${V%zu}-${V%zu} "},
+    {"escapes", "$$$$ $$ $$%zu %zu "},
+    {"unknown", "${U%zu} $U%zu "},
+};
+
+static char *generate(const Pattern *pat, size_t size, size_t nvars) {
+    char *text = malloc(size + 1);
+    char atom[64];
+    if (!text) {
+        return NULL;
+    }
+    for (size_t pos = 0, k = 0; pos < size; k++) {
+        int n = snprintf(atom, sizeof(atom), pat->fmt, k % nvars, (k + 1) % nvars);
+        size_t len = ((size_t)n < size - pos) ? (size_t)n : size - pos;
+        memcpy(text + pos, atom, len);
+        pos += len;
+    }
+    text[size] = '\0';
+    return text;
+}
+
+static char **KEYS, **VALS;
+
+static bool generate_vars(size_t count) {
+    KEYS = malloc(count * sizeof(char *));
+    VALS = malloc(count * sizeof(char *));
+    if (!KEYS || !VALS) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        KEYS[i] = malloc(16);
+        VALS[i] = malloc(24);
+        if (!KEYS[i] || !VALS[i]) {
+            return false;
+        }
+        snprintf(KEYS[i], 16, "V%zu", i);
+        snprintf(VALS[i], 24, "value %zu", i);
+    }
+    return true;
+}
+
+
+// --- measurements
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long peak_rss_kb(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+static FILE *DEVNULL;
+
+// measurements compared between engines
+typedef struct Measure {
+    bool ok;
+    double run_s;
+    size_t allocs;  // allocations made by alloc and run
+} Measure;
+
+// libc allocator counting malloc and realloc calls
+static size_t ALLOCS;
+
+static void *count_malloc(void *data, size_t size) {
+    (void)data;
+    ALLOCS++;
+    return malloc(size);
+}
+
+static void *count_realloc(void *data, void *ptr, size_t size) {
+    (void)data;
+    ALLOCS++;
+    return realloc(ptr, size);
+}
+
+static void count_free(void *data, void *ptr) {
+    (void)data;
+    free(ptr);
+}
+
+static const VsubAllocator COUNTING = {count_malloc, count_realloc, count_free, NULL, NULL};
+
+static cJSON *run_case(
+    const VsubSyntax *syntax, const VsubEngine *engine, const Pattern *pat,
+    const char *input, size_t size, size_t nvars, const char *skip, Measure *m
+) {
+    cJSON *res = cJSON_CreateObject();
+    cJSON_AddStringToObject(res, "syntax", syntax->name);
+    cJSON_AddStringToObject(res, "engine", engine->name);
+    cJSON_AddStringToObject(res, "pattern", pat->name);
+    cJSON_AddNumberToObject(res, "size", size);
+    cJSON_AddNumberToObject(res, "vars", nvars);
+    m->ok = false;
+    if (skip) {
+        cJSON_AddStringToObject(res, "skipped", skip);
+        return res;
+    }
+    Vsub sub;
+    double t0, t1, t2, t3, t4, t5, t6;
+    bool ok;
+
+    // in memory
+    t0 = now();
+    vsub_init_alloc(&sub, &COUNTING);
+    t1 = now();
+    sub.syntax = syntax;
+    sub.engine = engine;
+    vsub_UseTextFromStr(&sub, input);
+    vsub_UseVarsFromArrays(&sub, nvars, (const char **)KEYS, (const char **)VALS);
+    t2 = now();
+    size_t allocs = ALLOCS;
+    ok = vsub_alloc(&sub);
+    t3 = now();
+    ok = ok && vsub_run(&sub);
+    t4 = now();
+    allocs = ALLOCS - allocs;
+    ok = ok && vsub_OutputPlain(&sub, DEVNULL) == VSUB_SUCCESS;
+    t5 = now();
+    ok = ok && vsub_OutputJson(&sub, DEVNULL, false) == VSUB_SUCCESS;
+    t6 = now();
+    cJSON_AddBoolToObject(res, "ok", ok);
+    cJSON_AddNumberToObject(res, "resc", sub.resc);
+    cJSON_AddNumberToObject(res, "subc", sub.subc);
+    cJSON_AddNumberToObject(res, "init_s", t1 - t0);
+    cJSON_AddNumberToObject(res, "alloc_s", t3 - t2);
+    cJSON_AddNumberToObject(res, "run_s", t4 - t3);
+    cJSON_AddNumberToObject(res, "plain_s", t5 - t4);
+    cJSON_AddNumberToObject(res, "json_s", t6 - t5);
+    cJSON_AddNumberToObject(res, "mb_per_s", size / (double)MB / (t4 - t3));
+    cJSON_AddNumberToObject(res, "subst_per_s", sub.subc / (t4 - t3));
+    cJSON_AddNumberToObject(res, "allocs", allocs);
+    m->ok = ok;
+    m->run_s = t4 - t3;
+    m->allocs = allocs;
+    vsub_free(&sub);
+
+    // streamed to output sink
+    vsub_init(&sub);
+    sub.syntax = syntax;
+    sub.engine = engine;
+    vsub_UseTextFromStr(&sub, input);
+    vsub_UseVarsFromArrays(&sub, nvars, (const char **)KEYS, (const char **)VALS);
+    vsub_UseSinkFile(&sub, DEVNULL);
+    vsub_alloc(&sub);
+    t0 = now();
+    ok = vsub_run(&sub);
+    t1 = now();
+    cJSON_AddNumberToObject(res, "stream_s", ok ? t1 - t0 : -1);
+    vsub_free(&sub);
+
+    cJSON_AddNumberToObject(res, "peak_rss_kb", peak_rss_kb());
+    return res;
+}
+
+
+// --- peak memory
+
+#define MEMORY_BLOCK (64 * KB)  // generated input block, repeated up to input size
+
+// generated input streamed block by block, so that input takes no memory
+typedef struct RepeatSrc {
+    VsubTextSrc super;
+    const char *block;
+    size_t size;  // input size
+    size_t pos;
+} RepeatSrc;
+
+static size_t repeat_read(RepeatSrc *src, char *buf, size_t n) {
+    size_t i = src->pos % MEMORY_BLOCK;
+    n = (n < MEMORY_BLOCK - i) ? n : MEMORY_BLOCK - i;
+    n = (n < src->size - src->pos) ? n : src->size - src->pos;
+    memcpy(buf, src->block + i, n);
+    src->pos += n;
+    return n;
+}
+
+// render in forked process, so that peak RSS of every case is measured alone
+static cJSON *memory_case(
+    const VsubSyntax *syntax, const VsubEngine *engine, const Pattern *pat,
+    const char *block, size_t size, const char *skip
+) {
+    cJSON *res = cJSON_CreateObject();
+    cJSON_AddStringToObject(res, "syntax", syntax->name);
+    cJSON_AddStringToObject(res, "engine", engine->name);
+    cJSON_AddStringToObject(res, "pattern", pat->name);
+    cJSON_AddNumberToObject(res, "size", size);
+    if (skip) {
+        cJSON_AddStringToObject(res, "skipped", skip);
+        return res;
+    }
+    long rss[3] = {0, 0, 0};  // ok, base, peak
+    int fds[2];
+    pid_t pid = (pipe(fds) == 0) ? fork() : -1;
+    if (pid == 0) {
+        close(fds[0]);
+        rss[1] = peak_rss_kb();
+        Vsub sub;
+        vsub_init(&sub);
+        sub.syntax = syntax;
+        sub.engine = engine;
+        RepeatSrc *src = malloc(sizeof(RepeatSrc));  // freed by context
+        if (src) {
+            ((VsubTextSrc *)src)->name = "repeat";
+            ((VsubTextSrc *)src)->read = (size_t (*)(void *, char *, size_t))repeat_read;
+            ((VsubTextSrc *)src)->view = NULL;
+            ((VsubTextSrc *)src)->reset = NULL;
+            ((VsubTextSrc *)src)->close = NULL;
+            src->block = block;
+            src->size = size;
+            src->pos = 0;
+            vsub_SetTextSrc(&sub, (VsubTextSrc *)src);
+            vsub_UseVarsFromArrays(&sub, BENCH_VARS, (const char **)KEYS, (const char **)VALS);
+            vsub_UseSinkFile(&sub, DEVNULL);
+            rss[0] = vsub_alloc(&sub) && vsub_run(&sub);
+        }
+        vsub_free(&sub);
+        rss[2] = peak_rss_kb();
+        bool sent = write(fds[1], rss, sizeof(rss)) == sizeof(rss);
+        _exit(sent ? 0 : 1);
+    }
+    if (pid > 0) {
+        close(fds[1]);
+        if (read(fds[0], rss, sizeof(rss)) != sizeof(rss)) {
+            rss[0] = 0;
+        }
+        waitpid(pid, NULL, 0);
+        close(fds[0]);
+    }
+    cJSON_AddBoolToObject(res, "ok", rss[0]);
+    cJSON_AddNumberToObject(res, "base_rss_kb", rss[1]);
+    cJSON_AddNumberToObject(res, "peak_rss_kb", rss[2]);
+    return res;
+}
+
+
+// --- engine comparison
+
+// packcc memoizing parser (before) against memo-free scan engine (after)
+static void compare_engines(cJSON *comparison, const VsubSyntax *syntax, const Pattern *pat,
+    size_t size, size_t nvars, const Measure *m) {
+    const Measure *before = &m[VSUB_EN_PACKCC], *after = &m[VSUB_EN_SCAN];
+    if (!before->ok || !after->ok) {
+        return;  // skipped or failed
+    }
+    cJSON *cmp = cJSON_CreateObject();
+    cJSON_AddStringToObject(cmp, "syntax", syntax->name);
+    cJSON_AddStringToObject(cmp, "pattern", pat->name);
+    cJSON_AddNumberToObject(cmp, "size", size);
+    cJSON_AddNumberToObject(cmp, "vars", nvars);
+    cJSON_AddNumberToObject(cmp, "run_speedup", after->run_s > 0 ? before->run_s / after->run_s : 0);
+    cJSON_AddNumberToObject(cmp, "allocs_before", before->allocs);
+    cJSON_AddNumberToObject(cmp, "allocs_after", after->allocs);
+    cJSON_AddItemToArray(comparison, cmp);
+}
+
+
+// --- main
+
+static size_t parse_size(const char *s) {
+    char *end;
+    size_t n = strtoull(s, &end, 10);
+    switch (*end) {
+        case 'K': return n * KB;
+        case 'M': return n * MB;
+        case 'G': return n * GB;
+        default: return n;
+    }
+}
+
+static void print_usage(void) {
+    puts(
+        "usage: benchmark [options]\n"
+        "  options:\n"
+        "    --max-size=SIZE         largest input size, suffix K, M or G; default: 1G\n"
+        "    --max-vars=N            largest var set size; default: 100000\n"
+        "    --packcc-max-size=SIZE  largest input size for packcc engine; default: 1M\n"
+        "    -h, --help              show this help and exit"
+    );
+}
+
+#define BENCH_OPT_MAX_SIZE 1000
+#define BENCH_OPT_MAX_VARS 1001
+#define BENCH_OPT_PACKCC_MAX_SIZE 1002
+
+static struct option longopts[] = {
+    {"max-size", required_argument, 0, BENCH_OPT_MAX_SIZE},
+    {"max-vars", required_argument, 0, BENCH_OPT_MAX_VARS},
+    {"packcc-max-size", required_argument, 0, BENCH_OPT_PACKCC_MAX_SIZE},
+    {"help", no_argument, 0, 'h'},
+    {0, 0, 0, 0},
+};
+
+int main(int argc, char *argv[]) {
+    size_t max_size = GB;
+    size_t max_vars = 100000;
+    size_t packcc_max_size = MB;  // PackCC is much slower
+    int o;
+    while ((o = getopt_long(argc, argv, "h", longopts, NULL)) != -1) {
+        switch (o) {
+            case BENCH_OPT_MAX_SIZE:
+                max_size = parse_size(optarg);
+                break;
+            case BENCH_OPT_MAX_VARS:
+                max_vars = parse_size(optarg);
+                break;
+            case BENCH_OPT_PACKCC_MAX_SIZE:
+                packcc_max_size = parse_size(optarg);
+                break;
+            case 'h':
+                print_usage();
+                return 0;
+            default:
+                print_usage();
+                return 1;
+        }
+    }
+    size_t nvars_all = BENCH_VARS;
+    for (size_t v = 0; v < sizeof(VARS) / sizeof(VARS[0]); v++) {
+        if (VARS[v] <= max_vars && VARS[v] > nvars_all) {
+            nvars_all = VARS[v];
+        }
+    }
+    if (!(DEVNULL = fopen("/dev/null", "w")) || !generate_vars(nvars_all)) {
+        fputs("benchmark setup failed\n", stderr);
+        return 1;
+    }
+
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "version", VSUB_VERSION);
+    cJSON *results = cJSON_AddArrayToObject(root, "results");
+    cJSON *comparison = cJSON_AddArrayToObject(root, "comparison");
+    cJSON *memory = cJSON_AddArrayToObject(root, "memory");
+
+    // peak memory by input size, measured first while process memory is small
+    const Pattern *dense = &PATTERNS[1];
+    char *block = generate(dense, MEMORY_BLOCK, BENCH_VARS);
+    if (!block) {
+        fputs("benchmark input generation failed\n", stderr);
+        return 1;
+    }
+    for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]) && SIZES[s] <= max_size; s++) {
+        for (size_t x = 0; x < VSUB_SYNTAXES_COUNT; x++) {
+            for (size_t e = 0; e < VSUB_ENGINES_COUNT; e++) {
+                const VsubEngine *engine = &VSUB_ENGINES[e];
+                const char *skip = (engine->id == VSUB_EN_PACKCC && SIZES[s] > packcc_max_size) ?
+                    "exceeds packcc max size" : NULL;
+                cJSON_AddItemToArray(memory, memory_case(
+                    &VSUB_SYNTAXES[x], engine, dense, block, SIZES[s], skip));
+            }
+        }
+    }
+    free(block);
+
+    // input sizes
+    for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]) && SIZES[s] <= max_size; s++) {
+        for (size_t p = 0; p < sizeof(PATTERNS) / sizeof(PATTERNS[0]); p++) {
+            char *input = generate(&PATTERNS[p], SIZES[s], BENCH_VARS);
+            if (!input) {
+                fputs("benchmark input generation failed\n", stderr);
+                return 1;
+            }
+            for (size_t x = 0; x < VSUB_SYNTAXES_COUNT; x++) {
+                Measure m[VSUB_ENGINES_COUNT];
+                for (size_t e = 0; e < VSUB_ENGINES_COUNT; e++) {
+                    const VsubEngine *engine = &VSUB_ENGINES[e];
+                    const char *skip = (engine->id == VSUB_EN_PACKCC && SIZES[s] > packcc_max_size) ?
+                        "exceeds packcc max size" : NULL;
+                    cJSON_AddItemToArray(results, run_case(
+                        &VSUB_SYNTAXES[x], engine, &PATTERNS[p], input, SIZES[s], BENCH_VARS, skip, &m[e]));
+                }
+                compare_engines(comparison, &VSUB_SYNTAXES[x], &PATTERNS[p], SIZES[s], BENCH_VARS, m);
+            }
+            free(input);
+        }
+    }
+
+    // var set sizes
+    for (size_t v = 0; v < sizeof(VARS) / sizeof(VARS[0]) && VARS[v] <= max_vars; v++) {
+        size_t size = (BENCH_VARS_SIZE < max_size) ? BENCH_VARS_SIZE : max_size;
+        char *input = generate(dense, size, VARS[v]);
+        if (!input) {
+            fputs("benchmark input generation failed\n", stderr);
+            return 1;
+        }
+        for (size_t x = 0; x < VSUB_SYNTAXES_COUNT; x++) {
+            Measure m[VSUB_ENGINES_COUNT];
+            for (size_t e = 0; e < VSUB_ENGINES_COUNT; e++) {
+                cJSON_AddItemToArray(results, run_case(
+                    &VSUB_SYNTAXES[x], &VSUB_ENGINES[e], dense, input, size, VARS[v], NULL, &m[e]));
+            }
+            compare_engines(comparison, &VSUB_SYNTAXES[x], dense, size, VARS[v], m);
+        }
+        free(input);
+    }
+
+    char *text = cJSON_Print(root);
+    puts(text);
+    free(text);
+    cJSON_Delete(root);
+    fclose(DEVNULL);
+    for (size_t i = 0; i < nvars_all; i++) {
+        free(KEYS[i]);
+        free(VALS[i]);
+    }
+    free(KEYS);
+    free(VALS);
+    return 0;
+}
@@ -0,0 +1,56 @@
+// helpers shared by C tests
+
+#ifndef VSUB_TESTS_HELPERS_H
+#define VSUB_TESTS_HELPERS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define CHUNKS_SIZE (200 * 1024)  // input split into a few chunks of VSUB_CHUNK_MIN
+
+// counts failed checks in `failures` of the calling scope
+#define CHECK(cond, ...) if (!(cond)) { \
+    failures++; \
+    fprintf(stderr, __VA_ARGS__); \
+    fputs("\n", stderr); \
+}
+
+// NULL equals NULL only
+static inline bool str_eq(const char *a, const char *b) {
+    return (!a && !b) || (a && b && strcmp(a, b) == 0);
+}
+
+// line repeated up to size bytes, last copy is cut
+static inline char *generate(const char *line, size_t size) {
+    char *text = malloc(size + 1);
+    size_t n = strlen(line);
+    for (size_t i = 0; i < size; i++) {
+        text[i] = line[i % n];
+    }
+    text[size] = '\0';
+    return text;
+}
+
+// growing buffer, usable as sink; data is zero terminated
+typedef struct Buf {
+    char *data;
+    size_t len;
+} Buf;
+
+static inline bool buf_write(Buf *buf, const char *s, size_t n) {
+    char *data = realloc(buf->data, buf->len + n + 1);
+    if (!data) {
+        return false;
+    }
+    memcpy(data + buf->len, s, n);
+    buf->len += n;
+    data[buf->len] = '\0';
+    buf->data = data;
+    return true;
+}
+
+
+#endif  // VSUB_TESTS_HELPERS_H
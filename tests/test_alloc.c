@@ -0,0 +1,175 @@
+// custom allocators: all memory of context is returned at vsub_free, out of
+// memory is reported as error at any allocation, arena renders like libc;
+// parser memory doesn't grow with input size
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vsub.h"
+#include "helpers.h"
+
+
+// counts live allocations, fails after limit is reached
+typedef struct Counter {
+    size_t live;   // allocations not freed yet
+    size_t calls;  // malloc and realloc calls
+    size_t limit;  // calls before failing, 0 for unlimited
+} Counter;
+
+static void *cnt_malloc(Counter *c, size_t size) {
+    if (c->limit && ++c->calls > c->limit) {
+        return NULL;
+    }
+    void *ptr = malloc(size);
+    c->live += (ptr != NULL);
+    return ptr;
+}
+
+static void *cnt_realloc(Counter *c, void *ptr, size_t size) {
+    if (c->limit && ++c->calls > c->limit) {
+        return NULL;
+    }
+    void *newptr = realloc(ptr, size);
+    c->live += (newptr != NULL && ptr == NULL);
+    return newptr;
+}
+
+static void cnt_free(Counter *c, void *ptr) {
+    c->live -= (ptr != NULL);
+    free(ptr);
+}
+
+static bool discard(void *data, const char *s, size_t n) {
+    return true;
+}
+
+static const char *TEXT = "$VAR ${VAR}iable $$VAR ${UNDEF} $UNDEF ${VAR:-x} $EMPTY text\n";
+
+static void render(Vsub *sub, size_t s, size_t e, size_t threads, const char *text) {
+    sub->syntax = &VSUB_SYNTAXES[s];
+    sub->engine = &VSUB_ENGINES[e];
+    sub->threads = threads;
+    if (vsub_UseTextFromStr(sub, text) &&
+        vsub_UseVarsFromKvarray(sub, 2, (const char *[]){"VAR=value", "EMPTY="}) &&
+        vsub_alloc(sub)) {
+        vsub_run(sub);
+    } else {
+        sub->err = VSUB_ERR_MEMORY;
+    }
+}
+
+// fail every allocation in turn until render succeeds
+static size_t test_oom(size_t s, size_t e) {
+    size_t failures = 0;
+    Vsub ref;
+    vsub_init(&ref);
+    render(&ref, s, e, 1, TEXT);
+    for (size_t limit = 1;; limit++) {
+        Counter c = {0, 0, limit};
+        VsubAllocator alloc = {
+            (void *(*)(void *, size_t))cnt_malloc,
+            (void *(*)(void *, void *, size_t))cnt_realloc,
+            (void (*)(void *, void *))cnt_free,
+            NULL,
+            &c,
+        };
+        Vsub sub;
+        if (vsub_init_alloc(&sub, &alloc)) {
+            render(&sub, s, e, 1, TEXT);
+        } else {
+            sub.err = VSUB_ERR_MEMORY;
+        }
+        bool done = sub.err == ref.err && str_eq(sub.res, ref.res);
+        failures += !done && sub.err != VSUB_ERR_MEMORY;
+        vsub_free(&sub);
+        failures += (c.live != 0);
+        if (done || failures) {
+            if (failures) {
+                fprintf(stderr, "oom %s %s limit=%zu: err=%d live=%zu\n",
+                    VSUB_SYNTAXES[s].name, VSUB_ENGINES[e].name, limit, sub.err, c.live);
+            }
+            break;
+        }
+    }
+    vsub_free(&ref);
+    return failures;
+}
+
+static size_t test_arena(size_t s, size_t e, size_t threads, size_t block, const char *text) {
+    Vsub ref, sub;
+    vsub_init(&ref);
+    render(&ref, s, e, 1, text);
+    bool ok = vsub_init_arena(&sub, block);
+    render(&sub, s, e, threads, text);
+    ok = ok && sub.err == ref.err && sub.subc == ref.subc && str_eq(sub.res, ref.res);
+    if (!ok) {
+        fprintf(stderr, "arena %s %s threads=%zu block=%zu mismatch\n",
+            VSUB_SYNTAXES[s].name, VSUB_ENGINES[e].name, threads, block);
+    }
+    vsub_free(&sub);
+    vsub_free(&ref);
+    return ok ? 0 : 1;
+}
+
+// every '$A' reads the next '$' ahead, so parser never stops at block end
+static size_t test_bounded(size_t s, bool stream) {
+    size_t live[2];
+    for (size_t i = 0; i < 2; i++) {
+        char *text = generate("$A", CHUNKS_SIZE << (i * 3));
+        FILE *fp = stream ? tmpfile() : NULL;
+        if (fp) {
+            fputs(text, fp);
+            rewind(fp);
+        }
+        Counter c = {0, 0, 0};
+        VsubAllocator alloc = {
+            (void *(*)(void *, size_t))cnt_malloc,
+            (void *(*)(void *, void *, size_t))cnt_realloc,
+            (void (*)(void *, void *))cnt_free,
+            NULL,
+            &c,
+        };
+        Vsub sub;
+        vsub_init_alloc(&sub, &alloc);
+        sub.syntax = &VSUB_SYNTAXES[s];
+        sub.engine = &VSUB_ENGINES[VSUB_EN_PACKCC];
+        if (fp) {
+            vsub_UseTextFromFile(&sub, fp);
+        } else {
+            vsub_UseTextFromStr(&sub, text);
+        }
+        vsub_UseSink(&sub, (bool (*)(void *, const char *, size_t))discard, NULL);
+        vsub_alloc(&sub);
+        live[i] = vsub_run(&sub) ? c.live : 0;
+        vsub_free(&sub);
+        if (fp) {
+            fclose(fp);
+        }
+        free(text);
+    }
+    if (live[0] == 0 || live[1] != live[0]) {
+        fprintf(stderr, "bounded %s stream=%d: %zu allocations, %zu for 8x input\n",
+            VSUB_SYNTAXES[s].name, stream, live[0], live[1]);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void) {
+    size_t failures = 0;
+    char *large = generate(TEXT, CHUNKS_SIZE);
+
+    for (size_t s = 0; s < VSUB_SYNTAXES_COUNT; s++) {
+        for (size_t e = 0; e < VSUB_ENGINES_COUNT; e++) {
+            failures += test_oom(s, e);
+            failures += test_arena(s, e, 1, 0, TEXT);
+            failures += test_arena(s, e, 1, 64, TEXT);  // block per allocation
+            failures += test_arena(s, e, 4, 0, large);
+        }
+        failures += test_bounded(s, false);
+        failures += test_bounded(s, true);
+    }
+
+    free(large);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,155 @@
+// var allowlists: listed vars are substituted, other references are kept as
+// is, whatever the engine, and with templates, chunks and batches
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vsub.h"
+#include "helpers.h"
+
+
+static const char *TEXT = "$VAR ${VAR}iable ${OTHER} $OTHER $UNDEF ${UNDEF} é\n";
+static const char *EXPECTED = "value valueiable ${OTHER} $OTHER $UNDEF ${UNDEF} é\n";
+
+static const char *VARS[] = {"VAR=value", "OTHER=other"};
+
+static VsubAllowlist *ONLY;  // VAR only
+
+static void setup(Vsub *sub, size_t s, size_t e, const char *text) {
+    vsub_init(sub);
+    sub->syntax = &VSUB_SYNTAXES[s];
+    sub->engine = &VSUB_ENGINES[e];
+    sub->only = ONLY;
+    vsub_UseTextFromStr(sub, text);
+    vsub_UseVarsFromKvarray(sub, 2, VARS);
+    vsub_alloc(sub);
+}
+
+static size_t test_lookup(void) {
+    size_t failures = 0;
+    char name[32];
+    const char *names[200];
+    for (size_t i = 0; i < 200; i++) {
+        snprintf(name, sizeof(name), "NAME_%zu", i * 2);
+        names[i] = strdup(name);
+    }
+    VsubAllowlist *list = vsub_CompileAllowlist(200, names);
+    failures += !list;
+    for (size_t i = 0; i < 400 && list; i++) {
+        snprintf(name, sizeof(name), "NAME_%zu", i);
+        failures += vsub_AllowsVar(list, name, strlen(name)) != (i % 2 == 0);
+    }
+    failures += list && (vsub_AllowsVar(list, "", 0) || vsub_AllowsVar(list, "NAME_", 5));
+    failures += list && !vsub_AllowsVar(list, "NAME_24}", 7);  // name viewed in input
+    vsub_FreeAllowlist(list);
+    for (size_t i = 0; i < 200; i++) {
+        free((char *)names[i]);
+    }
+
+    // duplicates and empty names
+    list = vsub_CompileAllowlist(3, (const char *[]){"A", "", "A"});
+    failures += !list || !vsub_AllowsVar(list, "A", 1) || vsub_AllowsVar(list, "B", 1);
+    vsub_FreeAllowlist(list);
+    list = vsub_CompileAllowlist(0, NULL);
+    failures += !list || vsub_AllowsVar(list, "A", 1);
+    vsub_FreeAllowlist(list);
+    if (failures) {
+        fprintf(stderr, "lookup: %zu failures\n", failures);
+    }
+    return failures;
+}
+
+static size_t test_run(size_t s, size_t e) {
+    Vsub sub;
+    setup(&sub, s, e, TEXT);
+    vsub_run(&sub);
+    bool ok = sub.err == VSUB_SUCCESS && str_eq(sub.res, EXPECTED) && sub.subc == 2;
+    vsub_free(&sub);
+    if (!ok) {
+        fprintf(stderr, "run %s %s: mismatch\n", VSUB_SYNTAXES[s].name, VSUB_ENGINES[e].name);
+    }
+    return ok ? 0 : 1;
+}
+
+// template compiled without allowlist, rendered with and without it
+static size_t test_template(size_t s) {
+    Vsub sub;
+    setup(&sub, s, VSUB_EN_SCAN, TEXT);
+    sub.only = NULL;
+    VsubTemplate *tpl = vsub_compile(&sub);
+    sub.only = ONLY;
+    bool ok = tpl && vsub_render(&sub, tpl) && str_eq(sub.res, EXPECTED);
+    sub.only = NULL;
+    ok = ok && vsub_render(&sub, tpl) && sub.res && strstr(sub.res, "other other");
+    vsub_discard(tpl);
+    vsub_free(&sub);
+    if (!ok) {
+        fprintf(stderr, "template %s: mismatch\n", VSUB_SYNTAXES[s].name);
+    }
+    return ok ? 0 : 1;
+}
+
+static size_t test_chunks(size_t s, size_t e, const char *text, const char *expected) {
+    Vsub sub;
+    setup(&sub, s, e, text);
+    sub.threads = 4;
+    vsub_run(&sub);
+    bool ok = sub.err == VSUB_SUCCESS && str_eq(sub.res, expected);
+    vsub_free(&sub);
+    if (!ok) {
+        fprintf(stderr, "chunks %s %s: mismatch\n", VSUB_SYNTAXES[s].name, VSUB_ENGINES[e].name);
+    }
+    return ok ? 0 : 1;
+}
+
+static size_t test_batch(size_t s, size_t e) {
+    size_t failures = 0;
+    VsubJob jobs[16];
+    VsubJobResult results[16];
+    Vsub params;
+    setup(&params, s, e, TEXT);
+    VsubVarTable *table = vsub_ShareVars(&params);
+    for (size_t i = 0; i < 16; i++) {
+        jobs[i] = (VsubJob){.text = TEXT, .vars = table};
+    }
+    failures += !table || !vsub_run_batch(&params, jobs, results, 16, 4);
+    for (size_t i = 0; i < 16 && table; i++) {
+        failures += !str_eq(results[i].res, EXPECTED);
+    }
+    vsub_free_batch(results, table ? 16 : 0);
+    vsub_FreeVarTable(table);
+    vsub_free(&params);
+    if (failures) {
+        fprintf(stderr, "batch %s %s: %zu failures\n", VSUB_SYNTAXES[s].name, VSUB_ENGINES[e].name,
+            failures);
+    }
+    return failures;
+}
+
+int main(void) {
+    size_t failures = 0;
+
+    failures += test_lookup();
+    ONLY = vsub_CompileAllowlist(1, (const char *[]){"VAR"});
+    if (!ONLY) {
+        fputs("compile allowlist failed\n", stderr);
+        return 1;
+    }
+    size_t lines = CHUNKS_SIZE / strlen(TEXT);
+    char *text = generate(TEXT, lines * strlen(TEXT));
+    char *expected = generate(EXPECTED, lines * strlen(EXPECTED));
+
+    for (size_t s = 0; s < VSUB_SYNTAXES_COUNT; s++) {
+        for (size_t e = 0; e < VSUB_ENGINES_COUNT; e++) {
+            failures += test_run(s, e);
+            failures += test_chunks(s, e, text, expected);
+            failures += test_batch(s, e);
+        }
+        failures += test_template(s);
+    }
+
+    free(text);
+    free(expected);
+    vsub_FreeAllowlist(ONLY);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+// batch rendering compared to rendering every job with its own context
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vsub.h"
+#include "helpers.h"
+
+
+#define JOBS 240
+
+static const char *TEXTS[] = {
+    "$VAR ${VAR}iable $$VAR ${UNDEF} $UNDEF plain text $OTHER.\n",
+    "",
+    "invalid \xff utf-8 $VAR\n",
+    "${VAR:?is not set} ${UNDEF:?is not set} tail\n",
+    "no vars at all\n",
+    NULL,  // large input
+};
+#define TEXTS_COUNT (sizeof(TEXTS) / sizeof(TEXTS[0]))
+
+static VsubVarTable *TABLES[2];
+
+static VsubVarTable *make_table(const char *kv) {
+    Vsub sub;
+    vsub_init(&sub);
+    vsub_UseVarsFromKvarray(&sub, 2, (const char *[]){kv, "OTHER=other"});
+    VsubVarTable *table = vsub_ShareVars(&sub);
+    vsub_free(&sub);
+    return table;
+}
+
+// render job with its own context and compare results
+static size_t check(const Vsub *params, const VsubJob *job, const VsubJobResult *res, const Buf *out) {
+    Vsub sub;
+    vsub_init(&sub);
+    sub.syntax = params->syntax;
+    sub.engine = params->engine;
+    sub.maxres = params->maxres;
+    vsub_UseTextFromStr(&sub, job->text);
+    if (job->vars) {
+        vsub_UseVarsFromTable(&sub, job->vars);
+    }
+    vsub_alloc(&sub);
+    vsub_run(&sub);
+    const char *got = job->write ? out->data : res->res;
+    const char *want = (sub.err == VSUB_SUCCESS || !job->write) ? sub.res : NULL;
+    bool ok = (
+        res->err == sub.err && res->trunc == sub.trunc && res->inpc == sub.inpc &&
+        res->resc == sub.resc && res->subc == sub.subc &&
+        str_eq(res->errvar, sub.errvar) && str_eq(res->errmsg, sub.errmsg) &&
+        (sub.err != VSUB_SUCCESS || str_eq(got, want)) &&
+        (!job->write || !res->res)
+    );
+    vsub_free(&sub);
+    return ok ? 0 : 1;
+}
+
+static size_t run(const VsubSyntax *syntax, const VsubEngine *engine, size_t maxres, size_t threads,
+    size_t count) {
+    static VsubJob jobs[JOBS];
+    static VsubJobResult results[JOBS];
+    static Buf outs[JOBS];
+    Vsub params;
+    vsub_init(&params);
+    params.syntax = syntax;
+    params.engine = engine;
+    params.maxres = maxres;
+    for (size_t i = 0; i < count; i++) {
+        outs[i].data = NULL;
+        outs[i].len = 0;
+        jobs[i].text = TEXTS[i % TEXTS_COUNT];
+        jobs[i].vars = (i / 7 % 3 < 2) ? TABLES[i / 7 % 3] : NULL;
+        jobs[i].write = (i % 4 == 0) ? (bool (*)(void *, const char *, size_t))buf_write : NULL;
+        jobs[i].data = &outs[i];
+    }
+    bool ok = vsub_run_batch(&params, jobs, results, count, threads);
+    size_t failures = 0;
+    bool all = true;
+    for (size_t i = 0; i < count; i++) {
+        failures += check(&params, &jobs[i], &results[i], &outs[i]);
+        all = all && results[i].err == VSUB_SUCCESS;
+        free(outs[i].data);
+    }
+    failures += (ok != all);
+    vsub_free_batch(results, count);
+    vsub_free(&params);
+    if (failures) {
+        fprintf(stderr, "%s %s maxres=%zu threads=%zu count=%zu: %zu mismatches\n",
+            syntax->name, engine->name, maxres, threads, count, failures);
+    }
+    return failures;
+}
+
+int main(void) {
+    size_t failures = 0;
+
+    size_t size = 5000;
+    char *large = malloc(size + 1);
+    for (size_t i = 0; i < size; i++) {
+        large[i] = "ab $VAR ${OTHER}\n"[i % 17];
+    }
+    large[size] = '\0';
+    TEXTS[TEXTS_COUNT - 1] = large;
+    TABLES[0] = make_table("VAR=first");
+    TABLES[1] = make_table("VAR=second");
+    if (!TABLES[0] || !TABLES[1]) {
+        fputs("share vars failed\n", stderr);
+        return 1;
+    }
+
+    for (size_t s = 0; s < VSUB_SYNTAXES_COUNT; s++) {
+        for (size_t e = 0; e < VSUB_ENGINES_COUNT; e++) {
+            failures += run(&VSUB_SYNTAXES[s], &VSUB_ENGINES[e], 0, 4, JOBS);
+            failures += run(&VSUB_SYNTAXES[s], &VSUB_ENGINES[e], 40, 3, JOBS);
+        }
+    }
+    const VsubSyntax *sx = &VSUB_SYNTAXES[VSUB_SX_ENVSUBST];
+    failures += run(sx, &VSUB_ENGINES[VSUB_EN_SCAN], 0, 1, JOBS);
+    failures += run(sx, &VSUB_ENGINES[VSUB_EN_SCAN], 0, 0, JOBS);
+    failures += run(sx, &VSUB_ENGINES[VSUB_EN_PACKCC], 0, 8, 3);  // more threads than jobs
+
+    // empty batch
+    Vsub params;
+    vsub_init(&params);
+    failures += !vsub_run_batch(&params, NULL, NULL, 0, 4);
+    vsub_free(&params);
+
+    vsub_FreeVarTable(TABLES[0]);
+    vsub_FreeVarTable(TABLES[1]);
+    free(large);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,148 @@
+// binary input: every byte value is passed through as is, whatever the engine,
+// and with file input, templates and chunks; engines give identical results
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vsub.h"
+#include "helpers.h"
+
+
+static const char *VARS[] = {"A=a", "AB=ab"};
+
+// every byte alone and around var references
+static Buf make_text(void) {
+    Buf text = {NULL, 0};
+    for (int b = 0; b < 256; b++) {
+        char c = (char)b;
+        buf_write(&text, &c, 1);
+        buf_write(&text, "$", 1);
+        buf_write(&text, &c, 1);
+        buf_write(&text, "${", 2);
+        buf_write(&text, &c, 1);
+        buf_write(&text, "} $A", 4);
+        buf_write(&text, &c, 1);
+        buf_write(&text, "${A", 3);
+        buf_write(&text, &c, 1);
+        buf_write(&text, "}\n", 2);
+    }
+    return text;
+}
+
+static bool res_eq(const Vsub *sub, const char *data, size_t len) {
+    return sub->err == VSUB_SUCCESS && sub->res && sub->resc == len && memcmp(sub->res, data, len) == 0;
+}
+
+static void setup(Vsub *sub, size_t s, size_t e) {
+    vsub_init(sub);
+    sub->syntax = &VSUB_SYNTAXES[s];
+    sub->engine = &VSUB_ENGINES[e];
+    vsub_UseVarsFromKvarray(sub, 2, VARS);
+}
+
+static size_t check_buf(size_t s, size_t e, const Buf *text, const Buf *want, size_t threads) {
+    Vsub sub;
+    setup(&sub, s, e);
+    sub.threads = threads;
+    vsub_UseTextFromBuf(&sub, text->data, text->len);
+    vsub_alloc(&sub);
+    vsub_run(&sub);
+    bool ok = res_eq(&sub, want->data, want->len) && sub.inpc == text->len;
+    vsub_free(&sub);
+    return ok ? 0 : 1;
+}
+
+static size_t check_file(size_t s, size_t e, const Buf *text, const Buf *want) {
+    FILE *fp = tmpfile();
+    fwrite(text->data, 1, text->len, fp);
+    rewind(fp);
+    Vsub sub;
+    setup(&sub, s, e);
+    vsub_UseTextFromFile(&sub, fp);
+    vsub_alloc(&sub);
+    vsub_run(&sub);
+    bool ok = res_eq(&sub, want->data, want->len);
+    vsub_free(&sub);
+    fclose(fp);
+    return ok ? 0 : 1;
+}
+
+static size_t check_template(size_t s, const Buf *text, const Buf *want) {
+    Vsub sub;
+    setup(&sub, s, 0);
+    vsub_UseTextFromBuf(&sub, text->data, text->len);
+    vsub_alloc(&sub);
+    VsubTemplate *tpl = vsub_compile(&sub);
+    bool ok = tpl && vsub_render(&sub, tpl) && res_eq(&sub, want->data, want->len);
+    vsub_discard(tpl);
+    vsub_free(&sub);
+    return ok ? 0 : 1;
+}
+
+int main(void) {
+    size_t failures = 0;
+
+    // bytes other than '$' are copied as is
+    Buf plain = {NULL, 0};
+    for (int b = 0; b < 256; b++) {
+        char c = (char)b;
+        if (c != '$') {
+            buf_write(&plain, &c, 1);
+        }
+    }
+    for (size_t s = 0; s < VSUB_SYNTAXES_COUNT; s++) {
+        for (size_t e = 0; e < VSUB_ENGINES_COUNT; e++) {
+            failures += check_buf(s, e, &plain, &plain, 1);
+        }
+    }
+
+    // value is followed by the zero byte
+    Buf zero = {"$A\0${AB}\0", 9}, zres = {"a\0ab\0", 5};
+    for (size_t s = 0; s < VSUB_SYNTAXES_COUNT; s++) {
+        for (size_t e = 0; e < VSUB_ENGINES_COUNT; e++) {
+            failures += check_buf(s, e, &zero, &zres, 1);
+        }
+    }
+
+    // results of the first engine are expected from every input path
+    Buf text = make_text();
+    Buf large = {NULL, 0};
+    while (large.len < CHUNKS_SIZE) {
+        buf_write(&large, text.data, text.len);
+    }
+    for (size_t s = 0; s < VSUB_SYNTAXES_COUNT; s++) {
+        Vsub sub;
+        Buf want = {NULL, 0}, lwant = {NULL, 0};
+        setup(&sub, s, 0);
+        vsub_UseTextFromBuf(&sub, text.data, text.len);
+        vsub_alloc(&sub);
+        vsub_run(&sub);
+        if (sub.err == VSUB_SUCCESS && sub.res && sub.subc > 0) {  // var references are substituted
+            buf_write(&want, sub.res, sub.resc);
+        }
+        vsub_free(&sub);
+        for (size_t i = 0; i < large.len / text.len; i++) {
+            buf_write(&lwant, want.data, want.len);
+        }
+        failures += !want.data;
+        for (size_t e = 0; e < VSUB_ENGINES_COUNT && want.data; e++) {
+            size_t f = check_buf(s, e, &text, &want, 1) + check_file(s, e, &text, &want) +
+                check_buf(s, e, &large, &lwant, 4);
+            if (f) {
+                fprintf(stderr, "%s %s: %zu failures\n", VSUB_SYNTAXES[s].name, VSUB_ENGINES[e].name, f);
+            }
+            failures += f;
+        }
+        if (want.data && check_template(s, &text, &want)) {
+            fprintf(stderr, "template %s: failed\n", VSUB_SYNTAXES[s].name);
+            failures++;
+        }
+        free(want.data);
+        free(lwant.data);
+    }
+
+    free(plain.data);
+    free(text.data);
+    free(large.data);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+// chunked rendering on threads compared to serial rendering
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vsub.h"
+#include "helpers.h"
+
+
+static void render(Vsub *sub, size_t s, size_t e, size_t threads, size_t maxinp, const char *text, Buf *out) {
+    vsub_init(sub);
+    sub->syntax = &VSUB_SYNTAXES[s];
+    sub->engine = &VSUB_ENGINES[e];
+    sub->threads = threads;
+    sub->maxinp = maxinp;
+    vsub_UseTextFromStr(sub, text);
+    vsub_UseVarsFromKvarray(sub, 2, (const char *[]){"VAR=value", "EMPTY="});
+    if (out) {
+        vsub_UseSink(sub, (bool (*)(void *, const char *, size_t))buf_write, out);
+    }
+    vsub_alloc(sub);
+    vsub_run(sub);
+}
+
+static size_t compare(const char *name, size_t s, size_t e, size_t maxinp, const char *text, bool sink) {
+    Vsub serial, chunked;
+    Buf sout = {NULL, 0}, cout = {NULL, 0};
+    render(&serial, s, e, 1, maxinp, text, sink ? &sout : NULL);
+    render(&chunked, s, e, 4, maxinp, text, sink ? &cout : NULL);
+    bool ok = (
+        chunked.err == serial.err && chunked.trunc == serial.trunc &&
+        chunked.gcac == serial.gcac && chunked.gcbc == serial.gcbc &&
+        chunked.inpc == serial.inpc && chunked.resc == serial.resc && chunked.subc == serial.subc &&
+        str_eq(chunked.res, serial.res) && str_eq(cout.data, sout.data) &&
+        str_eq(chunked.errvar, serial.errvar) && str_eq(chunked.errmsg, serial.errmsg)
+    );
+    if (!ok) {
+        fprintf(stderr, "%s: %s %s maxinp=%zu sink=%d mismatch\n",
+            name, VSUB_SYNTAXES[s].name, VSUB_ENGINES[e].name, maxinp, sink);
+    }
+    vsub_free(&serial);
+    vsub_free(&chunked);
+    free(sout.data);
+    free(cout.data);
+    return ok ? 0 : 1;
+}
+
+int main(void) {
+    size_t failures = 0;
+    struct {
+        const char *name;
+        char *text;
+    } cases[] = {
+        {"vars", generate("$VAR ${VAR}iable $$VAR ${UNDEF} $UNDEF $EMPTY text é\n", CHUNKS_SIZE)},
+        {"dollar lines", generate("$\n$$\n$$$\n${\n${VAR\n}\n", CHUNKS_SIZE)},
+        {"no newlines", generate("$VAR ${UNDEF} ", CHUNKS_SIZE)},
+        {"short", generate("$VAR\n", 100)},
+        {"invalid utf-8", generate("$VAR ${UNDEF} text\n", CHUNKS_SIZE)},
+    };
+    cases[4].text[CHUNKS_SIZE / 2] = '\xff';  // error in a middle chunk
+    size_t count = sizeof(cases) / sizeof(cases[0]);
+
+    for (size_t i = 0; i < count; i++) {
+        for (size_t s = 0; s < VSUB_SYNTAXES_COUNT; s++) {
+            for (size_t e = 0; e < VSUB_ENGINES_COUNT; e++) {
+                failures += compare(cases[i].name, s, e, 0, cases[i].text, false);
+                failures += compare(cases[i].name, s, e, 0, cases[i].text, true);
+                failures += compare(cases[i].name, s, e, CHUNKS_SIZE / 3, cases[i].text, false);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        free(cases[i].text);
+    }
+    return failures ? 1 : 0;
+}
@@ -1,3 +1,4 @@
+import json
 from pathlib import Path
 
 import pytest
@@ -85,8 +86,14 @@ def test_options_precedence(exe: Executable, args, assertion):
 @pytest.mark.parametrize(
     'args,output', [
         # multiple paths
-        ('path1 path2', b'multiple paths not allowed\n'),
-        ('p1 p2 p3', b'multiple paths not allowed\n'),
+        ('path1 path2', b'multiple paths require --output-dir, --suffix or --manifest\n'),
+        ('p1 p2 p3', b'multiple paths require --output-dir, --suffix or --manifest\n'),
+        # output files
+        ('--suffix=.out', b'output files require input paths or --manifest\n'),
+        ('--output-dir=out', b'output files require input paths or --manifest\n'),
+        ('--suffix=.out -f json p1', b'output files support plain format only\n'),
+        ('-j x --suffix=.out p1', b'invalid jobs count: x\n'),
+        ('-j -1 --suffix=.out p1', b'invalid jobs count: -1\n'),
         # invalid option
         ('--dummy', b'invalid option: --dummy\n'),
         ('--dummy path', b'invalid option: --dummy\n'),
@@ -100,6 +107,9 @@ def test_options_precedence(exe: Executable, args, assertion):
         ('-sdummy', b'unsupported syntax: dummy\n'),
         ('--syntax dummy', b'unsupported syntax: dummy\n'),
         ('--syntax=dummy', b'unsupported syntax: dummy\n'),
+        # unsupported engine
+        ('--engine dummy', b'unsupported engine: dummy\n'),
+        ('--engine=dummy', b'unsupported engine: dummy\n'),
         # unable to open file: see test_file_missing()
         # unsupported output format
         ('--format dummy', b'unsupported output format: dummy\n'),
@@ -117,3 +127,179 @@ def test_file_missing(exe: Executable, tmp_path: Path):
     out = exe.run(f'{exe} {fn}')
     assert out.returncode != 0
     assert out.stderr == f'unable to open file: {fn}\n'
+
+
+# file input
+
+@pytest.mark.parametrize('engine', ['packcc', 'scan'])
+@pytest.mark.parametrize('input', ['', 'plain $VAR ${UNDEF}\n' * 1000])
+def test_file_input(exe: Executable, tmp_path: Path, engine: str, input: str):
+    fn = tmp_path / 'input.txt'
+    fn.write_text(input)
+    file = exe.run(f'{exe} --engine={engine} -v VAR=v {fn}')
+    pipe = exe.run(f'cat {fn} | {exe} --engine={engine} -v VAR=v')
+    assert file.returncode == pipe.returncode == 0
+    assert file.stdout == pipe.stdout == input.replace('$VAR', 'v')
+
+
+
+@pytest.mark.parametrize('engine', ['packcc', 'scan'])
+def test_file_input_threads(exe: Executable, tmp_path: Path, engine: str):
+    fn = tmp_path / 'input.txt'
+    fn.write_text('plain $VAR ${UNDEF} $$VAR\n' * 8000)
+    serial = exe.run(f'{exe} --engine={engine} -v VAR=v {fn}')
+    chunked = exe.run(f'{exe} --engine={engine} -j 4 -v VAR=v {fn}')
+    assert serial.returncode == chunked.returncode == 0
+    assert chunked.stdout == serial.stdout
+
+
+@pytest.mark.parametrize('engine', ['packcc', 'scan'])
+def test_file_input_binary(exe: Executable, tmp_path: Path, engine: str):
+    fn = tmp_path / 'input.bin'
+    fn.write_bytes(bytes(range(256)) + b'$VAR\x00\xff\n')
+    file = exe.run(f'{exe} --engine={engine} -v VAR=v {fn}', encoding=None)
+    pipe = exe.run(f'cat {fn} | {exe} --engine={engine} -v VAR=v', encoding=None)
+    assert file.returncode == pipe.returncode == 0
+    assert file.stdout == pipe.stdout == bytes(range(256)) + b'v\x00\xff\n'
+
+
+def test_env(exe: Executable):
+    out = exe.run(f"echo 'x$FOO ${{BAR}}' | FOO=hello {exe} -e")
+    assert out.returncode == 0
+    assert out.stdout == 'xhello ${BAR}\n'
+    out = exe.run(f"echo 'x$FOO' | FOO=hello {exe} -e -v FOO=var")
+    assert out.returncode == 0
+    assert out.stdout == 'xvar\n'
+
+
+# output files
+
+@pytest.mark.parametrize('engine', ['packcc', 'scan'])
+@pytest.mark.parametrize('jobs', [1, 4])
+def test_output_files(exe: Executable, tmp_path: Path, engine: str, jobs: int):
+    inputs = []
+    for i in range(20):
+        fn = tmp_path / f'in{i}.txt'
+        fn.write_text(f'file {i}: $VAR ${{UNDEF}}\n' * i)
+        inputs.append(fn)
+    paths = ' '.join(str(fn) for fn in inputs)
+    outdir = tmp_path / 'out'
+    outdir.mkdir()
+    out = exe.run(f'{exe} --engine={engine} -j {jobs} -v VAR=v --output-dir={outdir} {paths}')
+    assert out.returncode == 0
+    assert out.stdout == out.stderr == ''
+    out = exe.run(f'{exe} --engine={engine} -j {jobs} -v VAR=v --suffix=.out {paths}')
+    assert out.returncode == 0
+    for fn in inputs:
+        single = exe.run(f'{exe} --engine={engine} -v VAR=v {fn}')
+        assert (outdir / fn.name).read_text() == single.stdout
+        assert fn.with_name(fn.name + '.out').read_text() == single.stdout
+
+
+def test_output_files_errors(exe: Executable, tmp_path: Path):
+    good = tmp_path / 'good.txt'
+    good.write_text('$VAR\n')
+    binary = tmp_path / 'binary.txt'
+    binary.write_bytes(b'\xff\x00$VAR\n')
+    missing = tmp_path / 'missing.txt'
+    manifest = tmp_path / 'manifest.tsv'
+    manifest.write_text(
+        f'{good}\t{tmp_path}/good.out\n'
+        f'\n'
+        f'{binary}\t{tmp_path}/binary.out\n'
+        f'{missing}\t{tmp_path}/missing.out\n'
+        f'{good}\t{tmp_path}/nodir/good.out\n'
+    )
+    out = exe.run(f'{exe} --engine=scan -j 2 -v VAR=v --manifest={manifest}')
+    assert out.returncode != 0
+    assert out.stderr == (
+        f'unable to open file: {missing}\n'
+        f'file write error: {tmp_path}/nodir/good.out\n'
+        f'2 of 4 files failed\n'
+    )
+    assert (tmp_path / 'good.out').read_text() == 'v\n'
+    assert (tmp_path / 'binary.out').read_bytes() == b'\xff\x00v\n'
+
+
+def test_output_files_overwrite(exe: Executable, tmp_path: Path):
+    fn = tmp_path / 'input.txt'
+    fn.write_text('$VAR\n')
+    out = exe.run(f'{exe} --output-dir={tmp_path} {fn}')
+    assert out.returncode != 0
+    assert out.stderr == f'output file is input file: {fn}\n'
+    assert fn.read_text() == '$VAR\n'
+
+
+def test_output_files_duplicate(exe: Executable, tmp_path: Path):
+    for d in ('a', 'b'):
+        (tmp_path / d).mkdir()
+        (tmp_path / d / 'input.txt').write_text(f'{d} $VAR\n')
+    outdir = tmp_path / 'out'
+    outdir.mkdir()
+    out = exe.run(f'{exe} --output-dir={outdir} {tmp_path}/a/input.txt {tmp_path}/b/input.txt')
+    assert out.returncode != 0
+    assert out.stderr == f'output file is listed more than once: {outdir}/input.txt\n'
+    assert not (outdir / 'input.txt').exists()
+    manifest = tmp_path / 'manifest.tsv'
+    manifest.write_text(f'{tmp_path}/a/input.txt\t{outdir}/x\n{tmp_path}/b/input.txt\t{outdir}/x\n')
+    out = exe.run(f'{exe} --manifest={manifest}')
+    assert out.returncode != 0
+    assert out.stderr == f'output file is listed more than once: {outdir}/x\n'
+
+
+def test_manifest_invalid(exe: Executable, tmp_path: Path):
+    manifest = tmp_path / 'manifest.tsv'
+    manifest.write_text('in.txt\tout.txt\nin.txt out.txt\n')
+    out = exe.run(f'{exe} --manifest={manifest}')
+    assert out.returncode != 0
+    assert out.stderr == f'invalid manifest line 2: {manifest}\n'
+
+
+# var references
+
+@pytest.mark.parametrize('syntax', ['envsubst', 'compose243'])
+def test_list_vars(exe: Executable, tmp_path: Path, syntax: str):
+    fn = tmp_path / 'input.txt'
+    fn.write_text('a $A ${B} $$C ${A} $ ${ $1 é $A_1\n$B\n' * 1000)
+    file = exe.run(f'{exe} -s {syntax} --list-vars {fn}')
+    pipe = exe.run(f'cat {fn} | {exe} -s {syntax} --list-vars')
+    assert file.returncode == pipe.returncode == 0
+    assert file.stdout == pipe.stdout == 'A\t2000\t2\nB\t2000\t5\nA_1\t1000\t30\n'
+    out = exe.run(f'{exe} -s {syntax} --list-vars -f json {fn}')
+    assert out.returncode == 0
+    assert json.loads(out.stdout) == {'vars': [
+        {'name': 'A', 'count': 2000, 'first': 2},
+        {'name': 'B', 'count': 2000, 'first': 5},
+        {'name': 'A_1', 'count': 1000, 'first': 30},
+    ]}
+
+
+def test_list_vars_errors(exe: Executable, tmp_path: Path):
+    out = exe.run(f'echo | {exe} --list-vars -f pretty')
+    assert out.returncode != 0
+    assert out.stderr == '--list-vars supports plain and json formats only\n'
+    out = exe.run(f'{exe} --list-vars --suffix=.out {tmp_path}/x')
+    assert out.returncode != 0
+    assert out.stderr == "--list-vars doesn't write output files\n"
+
+
+# var allowlists
+
+@pytest.mark.parametrize('engine', ['packcc', 'scan'])
+def test_only(exe: Executable, tmp_path: Path, engine: str):
+    fn = tmp_path / 'input.txt'
+    fn.write_text('$A ${B} $C ${D} $HOME\n')
+    out = exe.run(f'{exe} --engine={engine} -v A=a -v B=b -v C=c --only=\'A,${{B}} $D\' {fn}')
+    assert out.returncode == 0
+    assert out.stdout == 'a b $C ${D} $HOME\n'
+    names = tmp_path / 'names.txt'
+    names.write_text('C\n\n$HOME\n')
+    out = exe.run(f'{exe} --engine={engine} -v A=a -v C=c -v HOME=h --only-from={names} {fn}')
+    assert out.returncode == 0
+    assert out.stdout == '$A ${B} c ${D} h\n'
+
+
+def test_only_invalid(exe: Executable):
+    out = exe.run(f'echo | {exe} --only=\'A,1B\'')
+    assert out.returncode != 0
+    assert out.stderr == 'invalid var name: 1B\n'
@@ -0,0 +1,62 @@
+// inputs over 2 GiB: positions don't wrap; sparse file is read through the
+// mmap source and rendered to a sink keeping the tail of the result
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "vsub.h"
+
+
+#define OFFSET ((size_t)1 << 31)  // zero bytes before the text
+#define TAIL 64
+
+static const char *TEXT = "$VAR ${VAR}\n";
+static const char *EXPECTED = "value value\n";
+
+typedef struct Tail {
+    char data[TAIL];
+    size_t len;  // total bytes written
+} Tail;
+
+static bool tail_write(Tail *tail, const char *s, size_t n) {
+    for (size_t i = (n > TAIL) ? n - TAIL : 0; i < n; i++) {
+        tail->data[(tail->len + i) % TAIL] = s[i];
+    }
+    tail->len += n;
+    return true;
+}
+
+int main(void) {
+    FILE *fp = tmpfile();
+    size_t n = strlen(TEXT);
+    if (!fp || fseeko(fp, OFFSET, SEEK_SET) != 0 || fwrite(TEXT, 1, n, fp) != n || fflush(fp) != 0) {
+        fputs("sparse file failed\n", stderr);
+        return 1;
+    }
+    size_t failures = 0;
+    for (size_t t = 1; t <= 4; t += 3) {
+        Tail tail = {.len = 0};
+        Vsub sub;
+        vsub_init(&sub);
+        sub.threads = t;
+        vsub_UseTextFromMmap(&sub, fileno(fp));
+        vsub_UseVarsFromKvarray(&sub, 1, (const char *[]){"VAR=value"});
+        vsub_UseSink(&sub, (bool (*)(void *, const char *, size_t))tail_write, &tail);
+        vsub_alloc(&sub);
+        bool ok = vsub_run(&sub);
+        size_t m = strlen(EXPECTED);
+        bool tail_ok = tail.len == OFFSET + m;
+        for (size_t i = 0; i < m && tail_ok; i++) {
+            tail_ok = tail.data[(OFFSET + i) % TAIL] == EXPECTED[i];
+        }
+        if (!ok || sub.inpc != OFFSET + n || sub.resc != OFFSET + m || sub.subc != 2 || !tail_ok) {
+            fprintf(stderr, "threads=%zu: err=%d inpc=%zu resc=%zu subc=%zu\n",
+                t, sub.err, sub.inpc, sub.resc, sub.subc);
+            failures++;
+        }
+        vsub_free(&sub);
+    }
+    fclose(fp);
+    return failures ? 1 : 0;
+}
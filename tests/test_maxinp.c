@@ -0,0 +1,68 @@
+// input limit: at most maxinp bytes are rendered from every text source, and
+// trunc is set only if input was longer than that
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vsub.h"
+#include "helpers.h"
+
+
+#define MAXINP 8
+
+static const char *TEXT = "$A-x${A}yz";  // reference ends at MAXINP
+
+static const struct {
+    size_t len;  // input length
+    const char *expected;
+    bool trunc;
+} CASES[] = {
+    {MAXINP - 1, "a-x${A", false},
+    {MAXINP, "a-xa", false},
+    {MAXINP + 1, "a-xa", true},
+};
+
+enum {SRC_BUF, SRC_FILE, SRC_MMAP, SRC_COUNT};
+static const char *SRC_NAMES[] = {"buf", "file", "mmap"};
+
+static int failures = 0;
+
+static void check(size_t e, int source, size_t c) {
+    size_t len = CASES[c].len;
+    FILE *fp = tmpfile();
+    fwrite(TEXT, 1, len, fp);
+    fflush(fp);
+    rewind(fp);
+    Vsub sub;
+    vsub_init(&sub);
+    sub.engine = &VSUB_ENGINES[e];
+    sub.maxinp = MAXINP;
+    if (source == SRC_BUF) {
+        vsub_UseTextFromBuf(&sub, TEXT, len);
+    }
+    else if (source == SRC_FILE) {
+        vsub_UseTextFromFile(&sub, fp);
+    }
+    else {
+        vsub_UseTextFromMmap(&sub, fileno(fp));
+    }
+    vsub_UseVarsFromKvarray(&sub, 1, (const char *[]){"A=a"});
+    vsub_alloc(&sub);
+    bool ok = vsub_run(&sub);
+    CHECK(ok && str_eq(sub.res, CASES[c].expected) && sub.trunc == CASES[c].trunc,
+        "%s %s len=%zu: '%s' != '%s', trunc=%d",
+        VSUB_ENGINES[e].name, SRC_NAMES[source], len, sub.res, CASES[c].expected, sub.trunc);
+    vsub_free(&sub);
+    fclose(fp);
+}
+
+int main(void) {
+    for (size_t e = 0; e < VSUB_ENGINES_COUNT; e++) {
+        for (int source = 0; source < SRC_COUNT; source++) {
+            for (size_t c = 0; c < sizeof(CASES) / sizeof(CASES[0]); c++) {
+                check(e, source, c);
+            }
+        }
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,130 @@
+// scanned var references must match the vars substituted while rendering;
+// lookups are memoized, so substitutions are counted by markers in the result
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vsub.h"
+#include "vsubio.h"
+#include "helpers.h"
+
+
+#define CASES 2000
+#define SIZE (300 * 1024)  // a few input blocks
+
+static int failures = 0;
+
+// vars source recording lookups in order, every var is set to its marker
+typedef struct Lookups {
+    VsubVarsSrc super;
+    char names[512][64];
+    char markers[512][16];
+    size_t counts[512];
+    size_t count;
+} Lookups;
+
+static const char *lookup(Lookups *src, const char *var, size_t len, size_t *vlen) {
+    size_t i = 0;
+    while (i < src->count && !(strlen(src->names[i]) == len && memcmp(src->names[i], var, len) == 0)) {
+        i++;
+    }
+    if (i == src->count) {
+        snprintf(src->names[i], sizeof(src->names[0]), "%.*s", (int)len, var);
+        snprintf(src->markers[i], sizeof(src->markers[0]), "\x01%zu\x02", i);
+        src->count++;
+    }
+    *vlen = strlen(src->markers[i]);
+    return src->markers[i];
+}
+
+// count markers of every looked up var in the result
+static void count_markers(Lookups *src, const char *res) {
+    for (size_t i = 0; i < src->count; i++) {
+        src->counts[i] = 0;
+        for (const char *p = res; p && (p = strstr(p, src->markers[i])); p++) {
+            src->counts[i]++;
+        }
+    }
+}
+
+static char *random_text(unsigned *seed, size_t len) {
+    static const char *PIECES[] = {"$", "$", "{", "}", "A", "b", "_", "1", " ", "\n", "é"};
+    char *text = malloc(len * 2 + 1);
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        *seed = *seed * 1103515245 + 12345;
+        const char *p = PIECES[(*seed >> 16) % (sizeof(PIECES) / sizeof(PIECES[0]))];
+        n = stpcpy(text + n, p) - text;
+    }
+    text[n] = '\0';
+    return text;
+}
+
+static void check(size_t s, const char *text) {
+    // rendering lookups
+    Vsub sub;
+    vsub_init(&sub);
+    sub.syntax = &VSUB_SYNTAXES[s];
+    Lookups *src = malloc(sizeof(Lookups));
+    src->super = (VsubVarsSrc){.name = "lookups", .getvalue = (const char *(*)(void *, const char *, size_t, size_t *))lookup};
+    src->count = 0;
+    vsub_AddVarsSrc(&sub, (VsubVarsSrc *)src);
+    vsub_UseTextFromStr(&sub, text);
+    vsub_alloc(&sub);
+    CHECK(vsub_run(&sub), "render failed: %s", text);
+    count_markers(src, sub.res);
+
+    // scanned refs
+    const VsubVarRef *refs;
+    size_t count;
+    vsub_SetTextFromStr(&sub, text);
+    CHECK(vsub_scan_vars(&sub, &refs, &count), "scan failed: %s", text);
+    CHECK(count == src->count, "%zu refs, %zu lookups: %s", count, src->count, text);
+    for (size_t i = 0; i < count && i < src->count; i++) {
+        const char *at = text + refs[i].first;
+        size_t braced = (at[1] == '{');
+        CHECK(strcmp(refs[i].name, src->names[i]) == 0 && refs[i].count == src->counts[i] &&
+            at[0] == '$' && strncmp(at + 1 + braced, refs[i].name, strlen(refs[i].name)) == 0,
+            "ref %zu %s mismatch: %s", i, refs[i].name, text);
+    }
+    vsub_free(&sub);
+}
+
+// streamed input across block boundaries scans like in memory
+static void check_stream(const char *text) {
+    Vsub mem, file;
+    const VsubVarRef *mrefs, *frefs;
+    size_t mcount, fcount;
+    FILE *fp = tmpfile();
+    fputs(text, fp);
+    rewind(fp);
+    vsub_init(&mem);
+    vsub_init(&file);
+    vsub_UseTextFromStr(&mem, text);
+    vsub_UseTextFromFile(&file, fp);
+    CHECK(vsub_scan_vars(&mem, &mrefs, &mcount) && vsub_scan_vars(&file, &frefs, &fcount),
+        "stream scan failed");
+    CHECK(mcount == fcount, "stream: %zu refs, %zu in memory", fcount, mcount);
+    for (size_t i = 0; i < mcount && i < fcount; i++) {
+        CHECK(strcmp(mrefs[i].name, frefs[i].name) == 0 && mrefs[i].count == frefs[i].count &&
+            mrefs[i].first == frefs[i].first, "stream: ref %zu mismatch", i);
+    }
+    vsub_free(&mem);
+    vsub_free(&file);
+    fclose(fp);
+}
+
+int main(void) {
+    unsigned seed = 1;
+    for (size_t i = 0; i < CASES; i++) {
+        char *text = random_text(&seed, i % 200);
+        for (size_t s = 0; s < VSUB_SYNTAXES_COUNT; s++) {
+            check(s, text);
+        }
+        free(text);
+    }
+    char *large = random_text(&seed, SIZE);
+    check_stream(large);
+    free(large);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,284 @@
+// context reused between runs compared to fresh contexts; steady-state runs of
+// a warm context are checked to make no heap allocations, counting is enabled
+// with glibc when not built with sanitizers, which intercept allocations too
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vsub.h"
+#include "vsubio.h"
+
+
+#define ROUNDS 50
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer)
+#define NO_COUNTING
+#endif
+#endif
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__) && !defined(__SANITIZE_THREAD__) && \
+    !defined(NO_COUNTING)
+#define COUNTING
+
+static size_t ALLOCS;  // allocations made by the process
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size) {
+    ALLOCS++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    ALLOCS++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    ALLOCS++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+#else
+static size_t ALLOCS;  // not counted
+#endif
+
+static const char *TEXTS[] = {
+    "$VAR ${VAR}iable $$VAR ${UNDEF} $UNDEF plain text $OTHER.\n",
+    "",
+    "${VAR:?is not set} ${UNDEF:-fallback} tail\n",
+    "no vars at all, but quite a long line of text to make the buffers grow\n",
+    "$OTHER$VAR$OTHER\n",
+};
+#define TEXTS_COUNT (sizeof(TEXTS) / sizeof(TEXTS[0]))
+
+static const char *VARS[] = {"VAR=value", "OTHER=other"};
+
+// fixed size sink, doesn't allocate
+typedef struct Out {
+    char data[256];
+    size_t len;
+} Out;
+
+static bool out_write(Out *out, const char *s, size_t n) {
+    if (out->len + n >= sizeof(out->data)) {
+        return false;
+    }
+    memcpy(out->data + out->len, s, n);
+    out->len += n;
+    out->data[out->len] = '\0';
+    return true;
+}
+
+static void setup(Vsub *sub, size_t s, size_t e) {
+    vsub_init(sub);
+    sub->syntax = &VSUB_SYNTAXES[s];
+    sub->engine = &VSUB_ENGINES[e];
+    vsub_UseVarsFromKvarray(sub, 2, VARS);
+}
+
+// results of text rendered by fresh context
+static char *EXPECTED[TEXTS_COUNT];
+static int ERR[TEXTS_COUNT];
+
+static void expect(size_t s, size_t e) {
+    for (size_t i = 0; i < TEXTS_COUNT; i++) {
+        Vsub sub;
+        setup(&sub, s, e);
+        vsub_UseTextFromStr(&sub, TEXTS[i]);
+        vsub_alloc(&sub);
+        vsub_run(&sub);
+        free(EXPECTED[i]);
+        EXPECTED[i] = sub.res ? strdup(sub.res) : NULL;
+        ERR[i] = sub.err;
+        vsub_free(&sub);
+    }
+}
+
+// empty result is NULL without sink
+static size_t check(const Vsub *sub, size_t i, const char *res) {
+    bool ok = sub->err == ERR[i] &&
+        (sub->err != VSUB_SUCCESS || strcmp(res ? res : "", EXPECTED[i] ? EXPECTED[i] : "") == 0);
+    return ok ? 0 : 1;
+}
+
+static size_t run_str(Vsub *sub, Out *out, size_t i) {
+    out->len = 0;
+    out->data[0] = '\0';
+    vsub_SetTextFromStr(sub, TEXTS[i]);
+    vsub_run(sub);
+    return check(sub, i, sub->sink ? out->data : sub->res);
+}
+
+static size_t test_str(size_t s, size_t e, bool sink) {
+    size_t failures = 0;
+    Out out;
+    Vsub sub;
+    setup(&sub, s, e);
+    if (sink) {
+        vsub_UseSink(&sub, (bool (*)(void *, const char *, size_t))out_write, &out);
+    }
+    vsub_alloc(&sub);
+    for (size_t i = 0; i < TEXTS_COUNT; i++) {  // warm-up
+        failures += run_str(&sub, &out, i);
+    }
+    size_t allocs = ALLOCS;
+    for (size_t r = 0; r < ROUNDS; r++) {
+        for (size_t i = 0; i < TEXTS_COUNT; i++) {
+            failures += run_str(&sub, &out, i);
+        }
+    }
+    failures += (ALLOCS != allocs);
+    // rerun the same input
+    for (size_t r = 0; r < ROUNDS; r++) {
+        out.len = 0;
+        failures += !vsub_reset(&sub);
+        vsub_run(&sub);
+        failures += check(&sub, TEXTS_COUNT - 1, sink ? out.data : sub.res);
+    }
+    failures += (ALLOCS != allocs);
+    vsub_free(&sub);
+    if (failures) {
+        fprintf(stderr, "str %s %s sink=%d: %zu failures, %zu allocations\n",
+            VSUB_SYNTAXES[s].name, VSUB_ENGINES[e].name, sink, failures, ALLOCS - allocs);
+    }
+    return failures;
+}
+
+static size_t test_file(size_t s, size_t e) {
+    size_t failures = 0;
+    FILE *fp = tmpfile();
+    fputs(TEXTS[0], fp);
+    fflush(fp);
+    Vsub sub;
+    setup(&sub, s, e);
+    vsub_SetTextFromFile(&sub, fp);
+    vsub_alloc(&sub);
+    size_t allocs = ALLOCS;
+    for (size_t r = 0; r < ROUNDS; r++) {
+        failures += !vsub_reset(&sub);
+        vsub_run(&sub);
+        failures += check(&sub, 0, sub.res);
+        if (r == 0) {
+            allocs = ALLOCS;  // warm-up
+        }
+    }
+    failures += (ALLOCS != allocs);
+    vsub_free(&sub);
+    fclose(fp);
+    if (failures) {
+        fprintf(stderr, "file %s %s: %zu failures\n", VSUB_SYNTAXES[s].name, VSUB_ENGINES[e].name,
+            failures);
+    }
+    return failures;
+}
+
+static size_t test_template(size_t s) {
+    size_t failures = 0;
+    Vsub sub;
+    setup(&sub, s, 0);
+    vsub_UseTextFromStr(&sub, TEXTS[0]);
+    vsub_alloc(&sub);
+    VsubTemplate *tpl = vsub_compile(&sub);
+    failures += !tpl || !vsub_render(&sub, tpl);  // warm-up
+    size_t allocs = ALLOCS;
+    for (size_t r = 0; r < ROUNDS && tpl; r++) {
+        vsub_render(&sub, tpl);
+        failures += check(&sub, 0, sub.res);
+    }
+    failures += (ALLOCS != allocs);
+    vsub_discard(tpl);
+    vsub_free(&sub);
+    if (failures) {
+        fprintf(stderr, "template %s: %zu failures\n", VSUB_SYNTAXES[s].name, failures);
+    }
+    return failures;
+}
+
+// streamed source in small blocks, counting reads at end of input
+typedef struct Stream {
+    VsubTextSrc super;
+    const char *text;
+    size_t i;
+    size_t eofs;
+} Stream;
+
+static size_t stream_read(Stream *src, char *buf, size_t n) {
+    size_t left = strlen(src->text + src->i);
+    n = (n < 7) ? n : 7;
+    n = (n < left) ? n : left;
+    memcpy(buf, src->text + src->i, n);
+    src->i += n;
+    src->eofs += (n == 0);
+    return n;
+}
+
+// input is parsed in one pass, reaching end of input once
+static size_t test_stream(size_t s, size_t e) {
+    size_t failures = 0;
+    Vsub sub;
+    setup(&sub, s, e);
+    vsub_alloc(&sub);
+    for (size_t i = 0; i < TEXTS_COUNT; i++) {
+        Stream *src = malloc(sizeof(Stream));  // freed by context
+        ((VsubTextSrc *)src)->name = "stream";
+        ((VsubTextSrc *)src)->read = (size_t (*)(void *, char *, size_t))stream_read;
+        ((VsubTextSrc *)src)->view = NULL;
+        ((VsubTextSrc *)src)->reset = NULL;
+        ((VsubTextSrc *)src)->close = NULL;
+        src->text = TEXTS[i];
+        src->i = 0;
+        src->eofs = 0;
+        vsub_SetTextSrc(&sub, (VsubTextSrc *)src);
+        vsub_run(&sub);
+        failures += check(&sub, i, sub.res) + (src->eofs != 1);
+    }
+    vsub_free(&sub);
+    if (failures) {
+        fprintf(stderr, "stream %s %s: %zu failures\n", VSUB_SYNTAXES[s].name, VSUB_ENGINES[e].name,
+            failures);
+    }
+    return failures;
+}
+
+int main(void) {
+    size_t failures = 0;
+
+    for (size_t s = 0; s < VSUB_SYNTAXES_COUNT; s++) {
+        for (size_t e = 0; e < VSUB_ENGINES_COUNT; e++) {
+            expect(s, e);
+            failures += test_str(s, e, false);
+            failures += test_str(s, e, true);
+            failures += test_file(s, e);
+            failures += test_stream(s, e);
+        }
+        expect(s, 0);
+        failures += test_template(s);
+    }
+
+    // rebinding a source of another kind
+    Vsub sub;
+    setup(&sub, VSUB_SX_ENVSUBST, VSUB_EN_SCAN);
+    FILE *fp = tmpfile();
+    vsub_UseTextFromFile(&sub, fp);
+    vsub_SetTextFromStr(&sub, "$VAR");
+    vsub_alloc(&sub);
+    vsub_run(&sub);
+    failures += !sub.res || strcmp(sub.res, "value") != 0;
+    vsub_free(&sub);
+    fclose(fp);
+
+    for (size_t i = 0; i < TEXTS_COUNT; i++) {
+        free(EXPECTED[i]);
+    }
+#ifdef COUNTING
+    puts("allocations counted");
+#endif
+    return failures ? 1 : 0;
+}
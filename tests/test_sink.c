@@ -0,0 +1,132 @@
+// output written to sinks must match the result accumulated in memory
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vsub.h"
+#include "helpers.h"
+
+
+static const char *INPUTS[] = {
+    "plaintext.",
+    "${VAR}iable $VAR-iable $$VAR-iable.",
+    "${UNDEF}-ined $UNDEF-ined ${VAR plain$.",
+    "",
+};
+
+static const char *KEYS[] = {"VAR"};
+static const char *VALS[] = {"value"};
+
+static int failures = 0;
+
+static void check_mem(const VsubSyntax *syntax, const VsubEngine *engine, const char *input) {
+    Vsub ref, snk;
+    char *buf;
+    size_t len;
+
+    vsub_init(&ref);
+    ref.syntax = syntax;
+    ref.engine = engine;
+    vsub_UseTextFromStr(&ref, input);
+    vsub_UseVarsFromArrays(&ref, 1, KEYS, VALS);
+    vsub_alloc(&ref);
+    vsub_run(&ref);
+
+    vsub_init(&snk);
+    snk.syntax = syntax;
+    snk.engine = engine;
+    vsub_UseTextFromStr(&snk, input);
+    vsub_UseVarsFromArrays(&snk, 1, KEYS, VALS);
+    vsub_UseSinkMem(&snk, &buf, &len);
+    vsub_alloc(&snk);
+    CHECK(vsub_run(&snk), "%s: run failed", input);
+    CHECK(snk.res == NULL, "%s: result not streamed", input);
+    CHECK(len == ref.resc && (len == 0 || strcmp(buf, ref.res) == 0),
+        "%s [%s/%s]: '%s' != '%s'", input, syntax->name, engine->name, buf, ref.res);
+    CHECK(snk.resc == ref.resc, "%s: resc %zu != %zu", input, snk.resc, ref.resc);
+    CHECK(snk.subc == ref.subc, "%s: subc %zu != %zu", input, snk.subc, ref.subc);
+
+    free(buf);
+    vsub_free(&snk);
+    vsub_free(&ref);
+}
+
+// input larger than output buffer, streamed in chunks
+
+typedef struct Chunks {
+    char *data;
+    size_t len;
+    size_t count;
+    size_t fail_after;  // fail on n-th write, or never if 0
+} Chunks;
+
+static bool write_chunk(Chunks *c, const char *buf, size_t n) {
+    if (c->fail_after && ++c->count >= c->fail_after) {
+        return false;
+    }
+    memcpy(c->data + c->len, buf, n);
+    c->len += n;
+    return true;
+}
+
+static void check_large(const VsubEngine *engine, size_t fail_after) {
+    const char *atom = "some text $VAR ";
+    const char *subst = "some text value ";
+    size_t count = 20000;
+    char *input = malloc(strlen(atom) * count + 1);
+    char *expected = malloc(strlen(subst) * count + 1);
+    Chunks chunks = {malloc(strlen(subst) * count), 0, 0, fail_after};
+    input[0] = expected[0] = '\0';
+    for (size_t i = 0; i < count; i++) {
+        strcpy(input + i * strlen(atom), atom);
+        strcpy(expected + i * strlen(subst), subst);
+    }
+
+    Vsub sub;
+    vsub_init(&sub);
+    sub.engine = engine;
+    vsub_UseTextFromStr(&sub, input);
+    vsub_UseVarsFromArrays(&sub, 1, KEYS, VALS);
+    vsub_UseSink(&sub, (bool (*)(void *, const char *, size_t))write_chunk, &chunks);
+    vsub_alloc(&sub);
+    bool ok = vsub_run(&sub);
+    if (fail_after) {
+        CHECK(!ok && sub.err == VSUB_ERR_FILE_WRITE, "%s: write error not reported", engine->name);
+    }
+    else {
+        CHECK(ok, "%s: large run failed", engine->name);
+        CHECK(chunks.len == strlen(expected) && memcmp(chunks.data, expected, chunks.len) == 0,
+            "%s: large result mismatch", engine->name);
+        CHECK(sub.resc == strlen(expected), "%s: large resc %zu", engine->name, sub.resc);
+        // same in memory
+        Vsub ref;
+        vsub_init(&ref);
+        ref.engine = engine;
+        vsub_UseTextFromStr(&ref, input);
+        vsub_UseVarsFromArrays(&ref, 1, KEYS, VALS);
+        vsub_alloc(&ref);
+        CHECK(vsub_run(&ref) && ref.res && strcmp(ref.res, expected) == 0,
+            "%s: large result in memory mismatch", engine->name);
+        vsub_free(&ref);
+    }
+
+    vsub_free(&sub);
+    free(chunks.data);
+    free(expected);
+    free(input);
+}
+
+int main(void) {
+    for (size_t s = 0; s < VSUB_SYNTAXES_COUNT; s++) {
+        for (size_t e = 0; e < VSUB_ENGINES_COUNT; e++) {
+            for (size_t i = 0; i < sizeof(INPUTS) / sizeof(INPUTS[0]); i++) {
+                check_mem(&VSUB_SYNTAXES[s], &VSUB_ENGINES[e], INPUTS[i]);
+            }
+        }
+    }
+    for (size_t e = 0; e < VSUB_ENGINES_COUNT; e++) {
+        check_large(&VSUB_ENGINES[e], 0);
+        check_large(&VSUB_ENGINES[e], 2);
+    }
+    return failures ? 1 : 0;
+}
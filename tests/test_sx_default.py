@@ -1,6 +1,7 @@
 import pytest
 
 
+@pytest.mark.parametrize('engine', ['packcc', 'scan'])
 @pytest.mark.parametrize(
     'input,result,vars', [
         ('plaintext', b'plaintext', ''),
@@ -10,9 +11,12 @@ import pytest
         ('${UNDEF}-ined', b'${UNDEF}-ined', ''),
         ('${}plain', b'${}plain', ''),
         ('${-}plain', b'${-}plain', ''),
+        ('${VAR', b'${VAR', '-v VAR=v'),
+        ('plain$', b'plain$', ''),
+        ('ünï$VAR©de', 'ünïv©de'.encode(), '-v VAR=v'),
     ]
 )
-def test_simple(exe, input, vars, result):
-    out = exe.run(f'echo -n \'{input}\' | {exe} {vars}', encoding=None)
+def test_simple(exe, engine, input, vars, result):
+    out = exe.run(f'echo -n \'{input}\' | {exe} --engine={engine} {vars}', encoding=None)
     assert out.returncode == 0
     assert out.stdout == result
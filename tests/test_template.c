@@ -0,0 +1,76 @@
+// compiled template rendering must match vsub_run for every syntax and engine
+
+#include <stdio.h>
+#include <string.h>
+#include "vsub.h"
+#include "helpers.h"
+
+
+static const char *INPUTS[] = {
+    "plaintext.",
+    "${VAR}iable.",
+    "$VAR-iable.",
+    "$$VAR-iable.",
+    "${UNDEF}-ined $UNDEF-ined.",
+    "${}plain ${-}plain ${VAR plain$.",
+    "$VAR$VAR ${VAR}${EMPTY}$EMPTY $VAR_2 ${VAR}$$",
+    "",
+};
+
+static const char *KEYS[] = {"VAR", "EMPTY", "VAR_2"};
+static const char *VALS[][3] = {
+    {"v", "", "two"},
+    {"value of var", "", "$VAR"},
+};
+
+static int failures = 0;
+
+static void check(const VsubSyntax *syntax, const VsubEngine *engine, const char *input) {
+    Vsub tpl, run;
+    VsubTemplate *t = NULL;
+
+    vsub_init(&tpl);
+    tpl.syntax = syntax;
+    tpl.engine = engine;
+    vsub_UseTextFromStr(&tpl, input);
+    CHECK(vsub_alloc(&tpl) && (t = vsub_compile(&tpl)), "%s: compile failed", input);
+
+    for (size_t i = 0; t && i < sizeof(VALS) / sizeof(VALS[0]); i++) {
+        // reference
+        vsub_init(&run);
+        run.syntax = syntax;
+        run.engine = engine;
+        vsub_UseTextFromStr(&run, input);
+        vsub_UseVarsFromArrays(&run, 3, KEYS, VALS[i]);
+        vsub_alloc(&run);
+        bool ok = vsub_run(&run);
+
+        // rendered
+        Vsub ren;
+        vsub_init(&ren);
+        vsub_UseVarsFromArrays(&ren, 3, KEYS, VALS[i]);
+        vsub_alloc(&ren);
+        CHECK(vsub_render(&ren, t) == ok, "%s: status mismatch", input);
+        CHECK((!ren.res && !run.res) || (ren.res && run.res && strcmp(ren.res, run.res) == 0),
+            "%s [%s/%s]: '%s' != '%s'", input, syntax->name, engine->name, ren.res, run.res);
+        CHECK(ren.resc == run.resc, "%s: resc %zu != %zu", input, ren.resc, run.resc);
+        CHECK(ren.subc == run.subc, "%s: subc %zu != %zu", input, ren.subc, run.subc);
+        CHECK(ren.inpc == run.inpc, "%s: inpc %zu != %zu", input, ren.inpc, run.inpc);
+        vsub_free(&ren);
+        vsub_free(&run);
+    }
+
+    vsub_discard(t);
+    vsub_free(&tpl);
+}
+
+int main(void) {
+    for (size_t s = 0; s < VSUB_SYNTAXES_COUNT; s++) {
+        for (size_t e = 0; e < VSUB_ENGINES_COUNT; e++) {
+            for (size_t i = 0; i < sizeof(INPUTS) / sizeof(INPUTS[0]); i++) {
+                check(&VSUB_SYNTAXES[s], &VSUB_ENGINES[e], INPUTS[i]);
+            }
+        }
+    }
+    return failures ? 1 : 0;
+}
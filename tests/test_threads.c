@@ -0,0 +1,117 @@
+// concurrent rendering with shared templates and var tables; meant to run
+// under ThreadSanitizer too, e.g. with meson setup -Db_sanitize=thread
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vsub.h"
+
+
+#define THREADS 8
+#define ROUNDS 100
+
+static const char *INPUT =
+    "$VAR ${VAR}iable $$VAR ${UNDEF} $UNDEF plain text $OTHER.\n"
+    "$VAR ${VAR}iable $$VAR ${UNDEF} $UNDEF plain text $OTHER.\n";
+
+static VsubTemplate *TPL[2];  // by syntax
+static char *EXPECTED[2];     // by syntax
+static VsubVarTable *TABLE;
+
+static size_t check(Vsub *sub, size_t s) {
+    return (sub->res && strcmp(sub->res, EXPECTED[s]) == 0) ? 0 : 1;
+}
+
+static void *worker(void *arg) {
+    size_t failures = 0;
+    Vsub sub;
+
+    // render shared templates with private context
+    vsub_init(&sub);
+    vsub_UseVarsFromTable(&sub, TABLE);
+    vsub_alloc(&sub);
+    for (size_t r = 0; r < ROUNDS; r++) {
+        for (size_t s = 0; s < VSUB_SYNTAXES_COUNT; s++) {
+            failures += !vsub_render(&sub, TPL[s]) || check(&sub, s);
+        }
+    }
+    vsub_free(&sub);
+
+    // parse with private context
+    for (size_t s = 0; s < VSUB_SYNTAXES_COUNT; s++) {
+        for (size_t e = 0; e < VSUB_ENGINES_COUNT; e++) {
+            vsub_init(&sub);
+            sub.syntax = &VSUB_SYNTAXES[s];
+            sub.engine = &VSUB_ENGINES[e];
+            vsub_UseTextFromStr(&sub, INPUT);
+            vsub_UseVarsFromTable(&sub, TABLE);
+            vsub_alloc(&sub);
+            failures += !vsub_run(&sub) || check(&sub, s);
+            vsub_free(&sub);
+        }
+    }
+    return (void *)failures;
+}
+
+int main(void) {
+    Vsub sub;
+
+    // shared var table outlives the context it was made from
+    vsub_init(&sub);
+    vsub_UseVarsFromArrays(&sub, 2, (const char *[]){"VAR", "OTHER"}, (const char *[]){"arr", "other"});
+    vsub_UseVarsFromKvarray(&sub, 1, (const char *[]){"VAR=value"});
+    TABLE = vsub_ShareVars(&sub);
+    vsub_free(&sub);
+    if (!TABLE) {
+        fputs("share vars failed\n", stderr);
+        return 1;
+    }
+
+    // shared templates and reference results
+    for (size_t s = 0; s < VSUB_SYNTAXES_COUNT; s++) {
+        vsub_init(&sub);
+        sub.syntax = &VSUB_SYNTAXES[s];
+        vsub_UseTextFromStr(&sub, INPUT);
+        vsub_alloc(&sub);
+        TPL[s] = vsub_compile(&sub);
+        vsub_free(&sub);
+
+        vsub_init(&sub);
+        sub.syntax = &VSUB_SYNTAXES[s];
+        vsub_UseTextFromStr(&sub, INPUT);
+        vsub_UseVarsFromTable(&sub, TABLE);
+        vsub_alloc(&sub);
+        if (!TPL[s] || !vsub_run(&sub) || !(EXPECTED[s] = strdup(sub.res))) {
+            fputs("reference failed\n", stderr);
+            return 1;
+        }
+        vsub_free(&sub);
+    }
+    if (!strstr(EXPECTED[0], "value") || strstr(EXPECTED[0], "arr")) {
+        fputs("var priority not kept\n", stderr);
+        return 1;
+    }
+
+    // run
+    pthread_t threads[THREADS];
+    size_t failures = 0;
+    for (size_t i = 0; i < THREADS; i++) {
+        pthread_create(&threads[i], NULL, worker, NULL);
+    }
+    for (size_t i = 0; i < THREADS; i++) {
+        void *ret;
+        pthread_join(threads[i], &ret);
+        failures += (size_t)ret;
+    }
+    if (failures) {
+        fprintf(stderr, "%zu mismatches\n", failures);
+    }
+
+    for (size_t s = 0; s < VSUB_SYNTAXES_COUNT; s++) {
+        vsub_discard(TPL[s]);
+        free(EXPECTED[s]);
+    }
+    vsub_FreeVarTable(TABLE);
+    return failures ? 1 : 0;
+}
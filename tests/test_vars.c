@@ -0,0 +1,227 @@
+// indexed and frozen vars sources must resolve like a first-match linear scan;
+// values are copied by length given by sources; lookups are memoized per run
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vsub.h"
+#include "vsubio.h"
+#include "helpers.h"
+
+
+#define COUNT 5000
+
+static int failures = 0;
+
+static void check(Vsub *sub, const char *input, const char *expected) {
+    vsub_UseTextFromStr(sub, input);
+    CHECK(vsub_alloc(sub) && vsub_run(sub), "%s: run failed", input);
+    CHECK(sub->res && strcmp(sub->res, expected) == 0, "%s: '%s' != '%s'", input, sub->res, expected);
+    vsub_free(sub);
+}
+
+// source that can't be enumerated
+static const char *getvalue_opaque(VsubVarsSrc *src, const char *var, size_t len, size_t *vlen) {
+    bool found = (len == 4 && memcmp(var, "VAR1", 4) == 0) || (len == 6 && memcmp(var, "OPAQUE", 6) == 0);
+    *vlen = found ? 6 : 0;
+    return found ? "opaque" : NULL;
+}
+
+// source with a value containing zero bytes
+static const char *getvalue_binary(VsubVarsSrc *src, const char *var, size_t len, size_t *vlen) {
+    *vlen = 5;
+    return "a\0b\0c";
+}
+
+static void check_binary(size_t e, bool template) {
+    VsubVarsSrc *binary = malloc(sizeof(VsubVarsSrc));
+    binary->name = "binary";
+    binary->getvalue = (const char *(*)(void *, const char *, size_t, size_t *))getvalue_binary;
+    binary->each = NULL;
+    binary->close = NULL;
+    Vsub sub;
+    vsub_init(&sub);
+    sub.engine = &VSUB_ENGINES[e];
+    vsub_AddVarsSrc(&sub, binary);
+    vsub_UseTextFromStr(&sub, "[$BIN ${BIN}]");
+    bool ok = vsub_alloc(&sub);
+    if (template) {
+        VsubTemplate *tpl = vsub_compile(&sub);
+        ok = ok && tpl && vsub_render(&sub, tpl);
+        vsub_discard(tpl);
+    }
+    else {
+        ok = ok && vsub_run(&sub);
+    }
+    CHECK(ok && sub.resc == 13 && memcmp(sub.res, "[a\0b\0c a\0b\0c]", 14) == 0,
+        "binary %s template=%d: unexpected result", VSUB_ENGINES[e].name, template);
+    vsub_free(&sub);
+}
+
+// source counting lookups, its value changes between runs
+typedef struct Counting {
+    VsubVarsSrc super;
+    const char *value;
+    size_t calls;
+} Counting;
+
+static const char *getvalue_counting(Counting *src, const char *var, size_t len, size_t *vlen) {
+    src->calls++;
+    bool found = (len >= 1 && var[0] == 'C');
+    *vlen = found ? strlen(src->value) : 0;
+    return found ? src->value : NULL;
+}
+
+static void check_memo(size_t e, bool template) {
+    Counting *counting = malloc(sizeof(Counting));
+    ((VsubVarsSrc *)counting)->name = "counting";
+    ((VsubVarsSrc *)counting)->getvalue = (const char *(*)(void *, const char *, size_t, size_t *))getvalue_counting;
+    ((VsubVarsSrc *)counting)->each = NULL;
+    ((VsubVarsSrc *)counting)->close = NULL;
+    counting->value = "x";
+    // repeated names, names colliding in memo and names too long to be memoized
+    static char text[8192];
+    char *p = text;
+    for (int r = 0; r < 100; r++) {
+        p += sprintf(p, "$C ${C} ${U} ");
+    }
+    for (int r = 0; r < 2; r++) {
+        for (int i = 0; i < 200; i++) {
+            p += sprintf(p, "$C%d ${U%d} ", i, i);
+        }
+    }
+    p += sprintf(p, "$C_NAME_THAT_IS_LONGER_THAN_MEMOIZED_NAMES $C_NAME_THAT_IS_LONGER_THAN_MEMOIZED_NAMES");
+    Vsub sub;
+    vsub_init(&sub);
+    sub.engine = &VSUB_ENGINES[e];
+    vsub_AddVarsSrc(&sub, (VsubVarsSrc *)counting);
+    vsub_UseTextFromStr(&sub, text);
+    VsubTemplate *tpl = NULL;
+    bool ok = vsub_alloc(&sub) && (!template || (tpl = vsub_compile(&sub)));
+    for (int run = 0; run < 2 && ok; run++) {
+        counting->calls = 0;
+        ok = template ? vsub_render(&sub, tpl) : (vsub_reset(&sub) && vsub_run(&sub));
+        size_t values = 0;
+        for (const char *c = ok ? sub.res : ""; *c; c++) {
+            values += (*c == counting->value[0]);
+        }
+        CHECK(ok && values == 200 + 400 + 2, "memo %s template=%d run=%d: %zu values",
+            VSUB_ENGINES[e].name, template, run, values);
+        // repeated names are looked up once, other names unless evicted
+        CHECK(counting->calls >= 2 + 400 + (template ? 1 : 2) && counting->calls <= 2 + 800 + 2,
+            "memo %s template=%d run=%d: %zu lookups", VSUB_ENGINES[e].name, template, run, counting->calls);
+        counting->value = "y";  // source changes between runs
+    }
+    vsub_discard(tpl);
+    vsub_free(&sub);
+}
+
+static void use_chain(Vsub *sub, const char **k, const char **v, bool freeze) {
+    VsubVarsSrc *opaque = malloc(sizeof(VsubVarsSrc));
+    opaque->name = "opaque";
+    opaque->getvalue = (const char *(*)(void *, const char *, size_t, size_t *))getvalue_opaque;
+    opaque->each = NULL;
+    opaque->close = NULL;
+    vsub_init(sub);
+    vsub_UseVarsFromArrays(sub, COUNT, k, v);
+    vsub_UseVarsFromEnv(sub);
+    vsub_AddVarsSrc(sub, opaque);
+    vsub_UseVarsFromKvarray(sub, 1, (const char *[]){"VAR0=kv"});
+    if (freeze) {
+        CHECK(vsub_FreezeVars(sub), "freeze failed");
+        const char *names[] = {"frozen", "opaque", "env", "frozen", NULL};  // env stays live
+        VsubVarsSrc *src = sub->vsrc;
+        for (size_t i = 0; names[i] || src; i++, src = src ? src->prev : NULL) {
+            CHECK(names[i] && src && strcmp(src->name, names[i]) == 0, "unexpected frozen chain");
+            if (!names[i] || !src) {
+                break;
+            }
+        }
+    }
+}
+
+int main(void) {
+    static char keys[COUNT][16], vals[COUNT][16], kvs[COUNT][32];
+    const char *k[COUNT + 1], *v[COUNT + 1], *kv[COUNT + 3];
+    for (size_t i = 0; i < COUNT; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "VAR%zu", i);
+        snprintf(vals[i], sizeof(vals[i]), "v%zu", i);
+        snprintf(kvs[i], sizeof(kvs[i]), "VAR%zu=v%zu", i, i);
+        k[i] = keys[i];
+        v[i] = vals[i];
+        kv[i] = kvs[i];
+    }
+    // duplicates and malformed items
+    k[COUNT] = "VAR0";
+    v[COUNT] = "dup";
+    kv[COUNT] = "VAR1=dup";
+    kv[COUNT + 1] = "NOEQ";
+    kv[COUNT + 2] = "EQ=a=b";
+
+    const char *input = "$VAR0 $VAR1 ${VAR4999} ${VAR5000} ${NOEQ} $EQ";
+    Vsub sub;
+
+    vsub_init(&sub);
+    vsub_UseVarsFromArrays(&sub, COUNT + 1, k, v);
+    check(&sub, input, "v0 v1 v4999 ${VAR5000} ${NOEQ} ");
+
+    vsub_init(&sub);
+    vsub_UseVarsFromKvarray(&sub, COUNT + 3, kv);
+    check(&sub, input, "v0 v1 v4999 ${VAR5000} ${NOEQ} a=b");
+
+    // sources added later take priority
+    vsub_init(&sub);
+    vsub_UseVarsFromArrays(&sub, COUNT + 1, k, v);
+    vsub_UseVarsFromKvarray(&sub, 3, (const char *[]){"VAR0=kv", "NOEQ", "EQ=a=b"});
+    check(&sub, input, "kv v1 v4999 ${VAR5000} ${NOEQ} a=b");
+
+    // empty sources
+    vsub_init(&sub);
+    vsub_UseVarsFromArrays(&sub, 0, k, v);
+    vsub_UseVarsFromKvarray(&sub, 0, kv);
+    check(&sub, "${VAR0}", "${VAR0}");
+
+    // environment snapshot, filtered by prefix
+    setenv("APP_VAR", "app", 1);
+    setenv("APP_EMPTY", "", 1);
+    setenv("OTHER_VAR", "other", 1);
+    vsub_init(&sub);
+    vsub_UseVarsFromEnvSnapshot(&sub, "APP_");
+    setenv("APP_VAR", "changed", 1);
+    check(&sub, "$APP_VAR ${APP_EMPTY}. ${OTHER_VAR}", "app . ${OTHER_VAR}");
+    vsub_init(&sub);
+    vsub_UseVarsFromEnvSnapshot(&sub, NULL);
+    check(&sub, "$APP_VAR $OTHER_VAR", "changed other");
+
+    // frozen snapshot owns copies of vars, as merged snapshot is closed
+    vsub_init(&sub);
+    vsub_UseVarsFromEnvSnapshot(&sub, "APP_");
+    vsub_UseVarsFromKvarray(&sub, 1, (const char *[]){"APP_EMPTY=kv"});
+    CHECK(vsub_FreezeVars(&sub), "freeze failed");
+    VsubVarsSrc *frozen = sub.vsrc;
+    CHECK(frozen && strcmp(frozen->name, "frozen") == 0 && !frozen->prev, "unexpected frozen snapshot chain");
+    check(&sub, "$APP_VAR ${APP_EMPTY}. ${OTHER_VAR}", "changed kv. ${OTHER_VAR}");
+
+    // frozen sources keep priority, opaque source stays in between
+    const char *chain = "$VAR0 $VAR1 $VAR2 $VAR3 ${OPAQUE} ${MISSING}";
+    const char *chained = "kv opaque env v3 opaque ${MISSING}";
+    setenv("VAR2", "env", 1);
+    for (int freeze = 0; freeze <= 1; freeze++) {
+        use_chain(&sub, k, v, freeze);
+        check(&sub, chain, chained);
+    }
+
+    // value lengths are given by sources
+    for (size_t e = 0; e < VSUB_ENGINES_COUNT; e++) {
+        check_binary(e, false);
+        check_binary(e, true);
+    }
+
+    // repeated lookups are memoized within run only
+    for (size_t e = 0; e < VSUB_ENGINES_COUNT; e++) {
+        check_memo(e, false);
+        check_memo(e, true);
+    }
+
+    return failures ? 1 : 0;
+}